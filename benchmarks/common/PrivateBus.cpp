@@ -0,0 +1,53 @@
+#include "PrivateBus.hpp"
+
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(lcSimplePrivateBus, "simple.privateBus", QtWarningMsg)
+
+PrivateBus::~PrivateBus()
+{
+    stop();
+}
+
+bool PrivateBus::start()
+{
+    m_process.start(QStringLiteral("dbus-daemon"), {
+                        QStringLiteral("--session"),
+                        QStringLiteral("--nofork"),
+                        QStringLiteral("--print-address=1"),
+                    });
+    if (!m_process.waitForStarted()) {
+        qCWarning(lcSimplePrivateBus) << "Unable to start dbus-daemon:" << m_process.errorString();
+        return false;
+    }
+
+    while (!m_process.canReadLine()) {
+        if (!m_process.waitForReadyRead(5000)) {
+            qCWarning(lcSimplePrivateBus) << "dbus-daemon did not report its address";
+            stop();
+            return false;
+        }
+    }
+
+    m_address = QString::fromLocal8Bit(m_process.readLine()).trimmed();
+    qputenv("DBUS_SESSION_BUS_ADDRESS", m_address.toLocal8Bit());
+    return true;
+}
+
+void PrivateBus::stop()
+{
+    if (m_process.state() == QProcess::NotRunning) {
+        return;
+    }
+    m_process.terminate();
+    if (!m_process.waitForFinished(3000)) {
+        m_process.kill();
+        m_process.waitForFinished();
+    }
+    m_address.clear();
+}
+
+QString PrivateBus::address() const
+{
+    return m_address;
+}
@@ -0,0 +1,24 @@
+#ifndef SIMPLE_PRIVATE_BUS_HPP
+#define SIMPLE_PRIVATE_BUS_HPP
+
+#include <QProcess>
+
+/* Runs a private dbus-daemon and makes it the session bus of the process */
+class PrivateBus
+{
+public:
+    PrivateBus() = default;
+    ~PrivateBus();
+
+    // Must be called before the first use of QDBusConnection::sessionBus()
+    bool start();
+    void stop();
+
+    QString address() const;
+
+protected:
+    QProcess m_process;
+    QString m_address;
+};
+
+#endif // SIMPLE_PRIVATE_BUS_HPP
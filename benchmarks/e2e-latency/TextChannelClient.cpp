@@ -0,0 +1,114 @@
+#include "TextChannelClient.hpp"
+
+#include <TelepathyQt/ChannelFactory>
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/ContactFactory>
+#include <TelepathyQt/PendingReady>
+#include <TelepathyQt/PendingSendMessage>
+
+#include <QLoggingCategory>
+
+#include <chrono>
+
+Q_LOGGING_CATEGORY(lcSimpleTextChannelClient, "simple.textChannelClient", QtWarningMsg)
+
+TextChannelClient::TextChannelClient(const QDBusConnection &bus, QObject *parent)
+    : QObject(parent)
+    , m_bus(bus)
+{
+}
+
+qint64 TextChannelClient::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TextChannelClient::setConnection(const QString &busName, const QString &objectPath)
+{
+    m_bus.connect(busName, objectPath, TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS, QLatin1String("NewChannels"),
+                  this, SLOT(onNewChannels(Tp::ChannelDetailsList)));
+
+    m_connection = Tp::Connection::create(m_bus, busName, objectPath,
+                                          Tp::ChannelFactory::create(m_bus),
+                                          Tp::ContactFactory::create());
+    const Tp::Features features = Tp::Features() << Tp::Connection::FeatureCore << Tp::Connection::FeatureConnected;
+    connect(m_connection->becomeReady(features), &Tp::PendingOperation::finished,
+            this, &TextChannelClient::onConnectionReady);
+}
+
+bool TextChannelClient::hasChannel() const
+{
+    return m_channelReady;
+}
+
+void TextChannelClient::send(const QString &text)
+{
+    if (!m_channelReady) {
+        return;
+    }
+    connect(m_channel->send(text), &Tp::PendingOperation::finished,
+            this, &TextChannelClient::onSendFinished);
+}
+
+void TextChannelClient::onConnectionReady(Tp::PendingOperation *operation)
+{
+    if (operation->isError()) {
+        qCWarning(lcSimpleTextChannelClient) << "Unable to make the connection ready:"
+                                             << operation->errorName() << operation->errorMessage();
+    }
+}
+
+void TextChannelClient::onNewChannels(const Tp::ChannelDetailsList &channels)
+{
+    if (m_channel || !m_connection) {
+        return;
+    }
+
+    for (const Tp::ChannelDetails &details : channels) {
+        const QString channelType = details.properties.value(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType")).toString();
+        if (channelType != TP_QT_IFACE_CHANNEL_TYPE_TEXT) {
+            continue;
+        }
+
+        m_channel = Tp::TextChannel::create(m_connection, details.channel.path(), details.properties);
+        const Tp::Features features = Tp::Features() << Tp::TextChannel::FeatureMessageQueue;
+        connect(m_channel->becomeReady(features), &Tp::PendingOperation::finished,
+                this, &TextChannelClient::onChannelReady);
+        return;
+    }
+}
+
+void TextChannelClient::onChannelReady(Tp::PendingOperation *operation)
+{
+    if (operation->isError()) {
+        qCWarning(lcSimpleTextChannelClient) << "Unable to make the channel ready:"
+                                             << operation->errorName() << operation->errorMessage();
+        return;
+    }
+
+    // The messages queued before the channel got ready are not signalled
+    const QList<Tp::ReceivedMessage> queue = m_channel->messageQueue();
+    for (const Tp::ReceivedMessage &message : queue) {
+        onMessageReceived(message);
+    }
+    connect(m_channel.data(), &Tp::TextChannel::messageReceived,
+            this, &TextChannelClient::onMessageReceived);
+
+    m_channelReady = true;
+    emit channelReady();
+}
+
+void TextChannelClient::onMessageReceived(const Tp::ReceivedMessage &message)
+{
+    const qint64 receivedAt = now();
+    emit messageReceived(message.text(), receivedAt);
+    m_channel->acknowledge(QList<Tp::ReceivedMessage>() << message);
+}
+
+void TextChannelClient::onSendFinished(Tp::PendingOperation *operation)
+{
+    if (operation->isError()) {
+        qCWarning(lcSimpleTextChannelClient) << "Unable to send a message:"
+                                             << operation->errorName() << operation->errorMessage();
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef SIMPLE_TEXT_CHANNEL_CLIENT_HPP
+#define SIMPLE_TEXT_CHANNEL_CLIENT_HPP
+
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/PendingOperation>
+#include <TelepathyQt/TextChannel>
+#include <TelepathyQt/Types>
+
+#include <QDBusConnection>
+#include <QObject>
+
+/* A Tp::TextChannel client of the first text channel announced by a connection */
+class TextChannelClient : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TextChannelClient(const QDBusConnection &bus, QObject *parent = nullptr);
+
+    void setConnection(const QString &busName, const QString &objectPath);
+    bool hasChannel() const;
+
+    void send(const QString &text);
+
+    // Monotonic clock shared with the service side (ns)
+    static qint64 now();
+
+signals:
+    void channelReady();
+    void messageReceived(const QString &text, qint64 receivedAt);
+
+protected slots:
+    void onConnectionReady(Tp::PendingOperation *operation);
+    void onNewChannels(const Tp::ChannelDetailsList &channels);
+    void onChannelReady(Tp::PendingOperation *operation);
+    void onMessageReceived(const Tp::ReceivedMessage &message);
+    void onSendFinished(Tp::PendingOperation *operation);
+
+protected:
+    QDBusConnection m_bus;
+    Tp::ConnectionPtr m_connection;
+    Tp::TextChannelPtr m_channel;
+    bool m_channelReady = false;
+};
+
+#endif // SIMPLE_TEXT_CHANNEL_CLIENT_HPP
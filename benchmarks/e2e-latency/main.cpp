@@ -0,0 +1,227 @@
+#ifndef SIMPLECM_ENABLE_LOWLEVEL_API
+#define SIMPLECM_ENABLE_LOWLEVEL_API
+#endif
+
+#include <SimpleCM/Message>
+#include <SimpleCM/Service>
+#include <SimpleCM/ServiceLowLevel>
+#include <SimpleCM/TrafficReplayer>
+
+#include <TelepathyQt/BaseConnection>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QTextStream>
+#include <QTimer>
+
+#include <functional>
+
+#include "PrivateBus.hpp"
+#include "TextChannelClient.hpp"
+
+static const QString c_peerId = QStringLiteral("e2e_peer");
+static const QString c_clientConnectionName = QStringLiteral("simplecm-e2e-client");
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+static const Qt::SplitBehavior c_skipEmptyParts = Qt::SkipEmptyParts;
+#else
+static const QString::SplitBehavior c_skipEmptyParts = QString::SkipEmptyParts;
+#endif
+
+// The text starts with "#<sequence> "
+static int sequenceOf(const QString &text)
+{
+    if (!text.startsWith(QLatin1Char('#'))) {
+        return -1;
+    }
+    const int end = text.indexOf(QLatin1Char(' '));
+    bool ok = false;
+    const int sequence = text.midRef(1, end < 0 ? -1 : end - 1).toInt(&ok);
+    return ok ? sequence : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Measures the message latency between Service and a Tp::TextChannel client "
+                                                    "over a private bus at several injection rates"));
+    parser.addHelpOption();
+
+    QCommandLineOption messagesOption(QStringLiteral("messages"), QStringLiteral("Messages per rate and direction."),
+                                      QStringLiteral("count"), QStringLiteral("2000"));
+    QCommandLineOption ratesOption(QStringLiteral("rates"), QStringLiteral("Comma separated injection rates (messages per second)."),
+                                   QStringLiteral("rates"), QStringLiteral("100,1000,5000"));
+    QCommandLineOption payloadOption(QStringLiteral("payload"), QStringLiteral("Message text size."),
+                                     QStringLiteral("bytes"), QStringLiteral("64"));
+    QCommandLineOption drainOption(QStringLiteral("drain-timeout"), QStringLiteral("Time to wait for the last messages of a run."),
+                                   QStringLiteral("msecs"), QStringLiteral("5000"));
+    parser.addOptions({ messagesOption, ratesOption, payloadOption, drainOption });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    PrivateBus privateBus;
+    if (!privateBus.start()) {
+        err << "Unable to start a private bus" << '\n';
+        return 1;
+    }
+
+    SimpleCM::Service service;
+    service.setManagerName(QStringLiteral("simplecmbench"));
+    service.setProtocolName(QStringLiteral("simplecm"));
+    if (!service.start()) {
+        err << "Unable to start the service" << '\n';
+        return 1;
+    }
+
+    Tp::DBusError error;
+    const QVariantMap parameters = {
+        { QStringLiteral("self_id"), QStringLiteral("bench_user") },
+    };
+    const Tp::BaseConnectionPtr connection = service.lowLevel()->createConnection(parameters, &error);
+    if (error.isValid()) {
+        err << "Unable to create a connection: " << error.name() << " " << error.message() << '\n';
+        return 1;
+    }
+
+    // The client has its own bus connection, as a separate process would
+    const QDBusConnection clientBus = QDBusConnection::connectToBus(QDBusConnection::SessionBus, c_clientConnectionName);
+    if (!clientBus.isConnected()) {
+        err << "Unable to connect the client to the bus" << '\n';
+        return 1;
+    }
+    TextChannelClient client(clientBus);
+    client.setConnection(connection->busName(), connection->objectPath());
+
+    struct Run {
+        bool inbound;
+        double rate;
+    };
+    QVector<Run> runs;
+    for (const QString &rate : parser.value(ratesOption).split(QLatin1Char(','), c_skipEmptyParts)) {
+        runs.append({ true, rate.toDouble() });
+        runs.append({ false, rate.toDouble() });
+    }
+
+    const int count = qMax(1, parser.value(messagesOption).toInt());
+    const int payload = qMax(1, parser.value(payloadOption).toInt());
+    const qint64 drainTimeout = parser.value(drainOption).toLongLong() * 1000000;
+
+    int runIndex = -1;
+    QVector<qint64> sentAt;
+    QVector<qint64> latencies;
+    int sent = 0;
+    qint64 startedAt = 0;
+    qint64 lastSentAt = 0;
+
+    auto textFor = [payload](int sequence) {
+        QString text = QStringLiteral("#%1 ").arg(sequence);
+        if (text.size() < payload) {
+            text.append(QString(payload - text.size(), QLatin1Char('x')));
+        }
+        return text;
+    };
+    auto record = [&](bool inbound, const QString &text, qint64 receivedAt) {
+        if ((runIndex < 0) || (runIndex >= runs.count()) || (runs.at(runIndex).inbound != inbound)) {
+            return;
+        }
+        const int sequence = sequenceOf(text);
+        if ((sequence < 0) || (sequence >= sent) || !sentAt.at(sequence)) {
+            return;
+        }
+        latencies.append((receivedAt - sentAt.at(sequence)) / 1000);
+        sentAt[sequence] = 0;
+    };
+
+    // Injection: Service::addMessage() -> MessageReceived on the client channel
+    QObject::connect(&client, &TextChannelClient::messageReceived, [&](const QString &text, qint64 receivedAt) {
+        record(true, text, receivedAt);
+    });
+    // Outbound: TextChannel::send() on the client -> Service::newMessage()
+    QObject::connect(&service, &SimpleCM::Service::newMessage, [&](const SimpleCM::Message &message) {
+        record(false, message.text, TextChannelClient::now());
+    });
+
+    auto inject = [&](int sequence) {
+        const QString text = textFor(sequence);
+        if (runs.at(runIndex).inbound) {
+            SimpleCM::Message message;
+            message.chat = SimpleCM::Chat::fromContactId(c_peerId);
+            message.from = c_peerId;
+            message.text = text;
+            sentAt[sequence] = TextChannelClient::now();
+            service.addMessage(message);
+        } else {
+            sentAt[sequence] = TextChannelClient::now();
+            client.send(text);
+        }
+    };
+
+    QTimer injectionTimer;
+    injectionTimer.setTimerType(Qt::PreciseTimer);
+    injectionTimer.setInterval(1);
+
+    std::function<void()> runNext = [&]() {
+        if (++runIndex == runs.count()) {
+            app.quit();
+            return;
+        }
+        sentAt = QVector<qint64>(count, 0);
+        latencies.clear();
+        latencies.reserve(count);
+        sent = 0;
+        startedAt = TextChannelClient::now();
+        injectionTimer.start();
+    };
+
+    QObject::connect(&injectionTimer, &QTimer::timeout, [&]() {
+        const Run &run = runs.at(runIndex);
+        const qint64 now = TextChannelClient::now();
+        const int due = qMin<qint64>(count, static_cast<qint64>(run.rate * (now - startedAt) / 1000000000.0));
+        while (sent < due) {
+            inject(sent++);
+            lastSentAt = TextChannelClient::now();
+        }
+
+        if ((sent < count) || ((latencies.count() < count) && (now - lastSentAt < drainTimeout))) {
+            return;
+        }
+        injectionTimer.stop();
+
+        const double achieved = (lastSentAt > startedAt) ? count * 1000000000.0 / (lastSentAt - startedAt) : 0;
+        out << (run.inbound ? "inbound " : "outbound") << " rate " << run.rate << "/s"
+            << " (achieved " << achieved << "/s)"
+            << ": received " << latencies.count() << "/" << count
+            << " latency (us): p50 " << SimpleCM::TrafficReplayReport::percentile(latencies, 50)
+            << " p90 " << SimpleCM::TrafficReplayReport::percentile(latencies, 90)
+            << " p99 " << SimpleCM::TrafficReplayReport::percentile(latencies, 99)
+            << " p999 " << SimpleCM::TrafficReplayReport::percentile(latencies, 99.9)
+            << " max " << SimpleCM::TrafficReplayReport::percentile(latencies, 100) << '\n';
+        out.flush();
+        QTimer::singleShot(0, &app, runNext);
+    });
+
+    // An incoming message opens the channel for the client
+    QTimer warmupTimer;
+    warmupTimer.setInterval(200);
+    QObject::connect(&warmupTimer, &QTimer::timeout, [&service]() {
+        SimpleCM::Message message;
+        message.chat = SimpleCM::Chat::fromContactId(c_peerId);
+        message.from = c_peerId;
+        message.text = QStringLiteral("warmup");
+        service.addMessage(message);
+    });
+    QObject::connect(&client, &TextChannelClient::channelReady, [&]() {
+        warmupTimer.stop();
+        QTimer::singleShot(0, &app, runNext);
+    });
+    warmupTimer.start();
+
+    const int result = app.exec();
+    QDBusConnection::disconnectFromBus(c_clientConnectionName);
+    return result;
+}
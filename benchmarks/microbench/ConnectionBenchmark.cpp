@@ -0,0 +1,243 @@
+#include "ConnectionBenchmark.hpp"
+
+#include "Chat.hpp"
+#include "JsonUtils.hpp"
+#include "textchannel.h"
+
+#include <TelepathyQt/Constants>
+
+#include <QDBusConnection>
+#include <QTest>
+
+static QStringList contactIdentifiers(const QString &prefix, int count)
+{
+    QStringList result;
+    result.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        result << prefix + QString::number(i);
+    }
+    return result;
+}
+
+static Tp::MessagePartList textMessage(int parts, int textSize)
+{
+    Tp::MessagePart header;
+    header[QLatin1String("message-sender-id")] = QDBusVariant(QLatin1String("contact0"));
+    header[QLatin1String("message-received")] = QDBusVariant(1500000000u);
+    header[QLatin1String("message-type")] = QDBusVariant(Tp::ChannelTextMessageTypeNormal);
+
+    Tp::MessagePartList message;
+    message << header;
+    for (int i = 0; i < parts; ++i) {
+        Tp::MessagePart body;
+        body[QLatin1String("content-type")] = QDBusVariant(QLatin1String("text/plain"));
+        body[QLatin1String("content")] = QDBusVariant(QString(textSize, QLatin1Char('x')));
+        message << body;
+    }
+    return message;
+}
+
+ConnectionBenchmark::ConnectionBenchmark(bool hasBus, QObject *parent)
+    : QObject(parent)
+    , m_hasBus(hasBus)
+{
+}
+
+SimpleConnectionPtr ConnectionBenchmark::createConnection(int rosterSize)
+{
+    const QVariantMap parameters = {
+        { QStringLiteral("self_id"), QStringLiteral("bench%1").arg(++m_connectionIndex) },
+    };
+    SimpleConnectionPtr connection = Tp::BaseConnection::create<SimpleConnection>(QDBusConnection::sessionBus(),
+                                                                                 QStringLiteral("simplecmbench"),
+                                                                                 QStringLiteral("simplecm"),
+                                                                                 parameters);
+    if (m_hasBus) {
+        Tp::DBusError error;
+        connection->registerObject(&error);
+    }
+    connection->setContactList(contactIdentifiers(QStringLiteral("contact"), rosterSize));
+    return connection;
+}
+
+void ConnectionBenchmark::ensureContact_data()
+{
+    QTest::addColumn<int>("rosterSize");
+    QTest::newRow("roster-100") << 100;
+    QTest::newRow("roster-10000") << 10000;
+    QTest::newRow("roster-100000") << 100000;
+}
+
+void ConnectionBenchmark::ensureContact()
+{
+    QFETCH(int, rosterSize);
+    SimpleConnectionPtr connection = createConnection(rosterSize);
+    const QStringList identifiers = contactIdentifiers(QStringLiteral("contact"), qMin(rosterSize, 1000));
+
+    QBENCHMARK {
+        for (const QString &identifier : identifiers) {
+            connection->ensureContact(identifier);
+        }
+    }
+}
+
+void ConnectionBenchmark::addContacts_data()
+{
+    QTest::addColumn<int>("rosterSize");
+    QTest::addColumn<int>("batchSize");
+    QTest::newRow("roster-100-batch-1") << 100 << 1;
+    QTest::newRow("roster-100-batch-1000") << 100 << 1000;
+    QTest::newRow("roster-10000-batch-1") << 10000 << 1;
+    QTest::newRow("roster-10000-batch-1000") << 10000 << 1000;
+}
+
+void ConnectionBenchmark::addContacts()
+{
+    QFETCH(int, rosterSize);
+    QFETCH(int, batchSize);
+    SimpleConnectionPtr connection = createConnection(rosterSize);
+
+    // Every iteration adds new contacts, so the roster grows with the iteration count
+    int iteration = 0;
+    QBENCHMARK {
+        const QStringList batch = contactIdentifiers(QStringLiteral("new%1-").arg(++iteration), batchSize);
+        connection->addContacts(batch);
+    }
+}
+
+void ConnectionBenchmark::getContactAttributes_data()
+{
+    QTest::addColumn<int>("rosterSize");
+    QTest::addColumn<int>("batchSize");
+    QTest::newRow("roster-1000-batch-1") << 1000 << 1;
+    QTest::newRow("roster-1000-batch-100") << 1000 << 100;
+    QTest::newRow("roster-100000-batch-100") << 100000 << 100;
+    QTest::newRow("roster-100000-batch-10000") << 100000 << 10000;
+}
+
+void ConnectionBenchmark::getContactAttributes()
+{
+    QFETCH(int, rosterSize);
+    QFETCH(int, batchSize);
+    SimpleConnectionPtr connection = createConnection(rosterSize);
+    const Tp::UIntList handles = connection->ensureContacts(contactIdentifiers(QStringLiteral("contact"), batchSize));
+    const QStringList interfaces = {
+        TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST,
+        TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE,
+    };
+
+    Tp::DBusError error;
+    QBENCHMARK {
+        connection->getContactAttributes(handles, interfaces, &error);
+    }
+}
+
+void ConnectionBenchmark::getContactListAttributes_data()
+{
+    QTest::addColumn<int>("rosterSize");
+    QTest::newRow("roster-100") << 100;
+    QTest::newRow("roster-10000") << 10000;
+    QTest::newRow("roster-100000") << 100000;
+}
+
+void ConnectionBenchmark::getContactListAttributes()
+{
+    QFETCH(int, rosterSize);
+    SimpleConnectionPtr connection = createConnection(rosterSize);
+
+    Tp::DBusError error;
+    QBENCHMARK {
+        connection->getContactListAttributes(QStringList(), false, &error);
+    }
+}
+
+void ConnectionBenchmark::receiveMessage_data()
+{
+    QTest::addColumn<int>("rosterSize");
+    QTest::addColumn<int>("senders");
+    QTest::newRow("roster-100-senders-1") << 100 << 1;
+    QTest::newRow("roster-100-senders-100") << 100 << 100;
+    QTest::newRow("roster-10000-senders-100") << 10000 << 100;
+}
+
+void ConnectionBenchmark::receiveMessage()
+{
+    if (!m_hasBus) {
+        QSKIP("The text channels need a bus");
+    }
+    QFETCH(int, rosterSize);
+    QFETCH(int, senders);
+    SimpleConnectionPtr connection = createConnection(rosterSize);
+    const QStringList identifiers = contactIdentifiers(QStringLiteral("contact"), senders);
+
+    // Open the channels outside of the measurement
+    for (const QString &identifier : identifiers) {
+        connection->ensureTextChannel(SimpleCM::Chat::fromContactId(identifier));
+    }
+
+    int index = 0;
+    QBENCHMARK {
+        connection->receiveMessage(identifiers.at(index), QStringLiteral("Hello"));
+        index = (index + 1) % identifiers.count();
+    }
+}
+
+void ConnectionBenchmark::addIncomingMessage_data()
+{
+    QTest::addColumn<int>("textSize");
+    QTest::newRow("text-16") << 16;
+    QTest::newRow("text-4096") << 4096;
+}
+
+void ConnectionBenchmark::addIncomingMessage()
+{
+    if (!m_hasBus) {
+        QSKIP("The text channels need a bus");
+    }
+    QFETCH(int, textSize);
+    SimpleConnectionPtr connection = createConnection(1);
+    const SimpleTextChannelPtr channel = connection->ensureTextChannel(SimpleCM::Chat::fromContactId(QStringLiteral("contact0")));
+    QVERIFY(channel);
+    const QString text(textSize, QLatin1Char('x'));
+
+    // The messages stay pending, so this includes the growth of the pending queue
+    QBENCHMARK {
+        channel->addIncomingMessage(text);
+    }
+}
+
+void ConnectionBenchmark::messageToJson_data()
+{
+    QTest::addColumn<int>("parts");
+    QTest::addColumn<int>("textSize");
+    QTest::newRow("parts-1-text-16") << 1 << 16;
+    QTest::newRow("parts-1-text-4096") << 1 << 4096;
+    QTest::newRow("parts-8-text-256") << 8 << 256;
+}
+
+void ConnectionBenchmark::messageToJson()
+{
+    QFETCH(int, parts);
+    QFETCH(int, textSize);
+    const Tp::MessagePartList message = textMessage(parts, textSize);
+
+    QBENCHMARK {
+        SimpleCM::JsonUtils::messageToJson(message);
+    }
+}
+
+void ConnectionBenchmark::messageFromJson_data()
+{
+    messageToJson_data();
+}
+
+void ConnectionBenchmark::messageFromJson()
+{
+    QFETCH(int, parts);
+    QFETCH(int, textSize);
+    const QByteArray json = SimpleCM::JsonUtils::messageToJson(textMessage(parts, textSize));
+
+    QBENCHMARK {
+        SimpleCM::JsonUtils::messageFromJson(json);
+    }
+}
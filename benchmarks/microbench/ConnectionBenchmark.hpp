@@ -0,0 +1,40 @@
+#ifndef SIMPLE_CONNECTION_BENCHMARK_HPP
+#define SIMPLE_CONNECTION_BENCHMARK_HPP
+
+#include <QObject>
+
+#include "connection.h"
+
+class ConnectionBenchmark : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ConnectionBenchmark(bool hasBus, QObject *parent = nullptr);
+
+private slots:
+    void ensureContact_data();
+    void ensureContact();
+    void addContacts_data();
+    void addContacts();
+    void getContactAttributes_data();
+    void getContactAttributes();
+    void getContactListAttributes_data();
+    void getContactListAttributes();
+    void receiveMessage_data();
+    void receiveMessage();
+    void addIncomingMessage_data();
+    void addIncomingMessage();
+    void messageToJson_data();
+    void messageToJson();
+    void messageFromJson_data();
+    void messageFromJson();
+
+private:
+    // A registered connection with a roster of the given size (the contacts are "contact<N>")
+    SimpleConnectionPtr createConnection(int rosterSize);
+
+    bool m_hasBus = false;
+    int m_connectionIndex = 0;
+};
+
+#endif // SIMPLE_CONNECTION_BENCHMARK_HPP
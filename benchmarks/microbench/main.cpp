@@ -0,0 +1,31 @@
+#include <TelepathyQt/Debug>
+#include <TelepathyQt/Types>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QLoggingCategory>
+#include <QTest>
+
+#include "ConnectionBenchmark.hpp"
+#include "PrivateBus.hpp"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // The debug output of the hot paths would dominate the measurements
+    QLoggingCategory::setFilterRules(QStringLiteral("*.debug=false"));
+    Tp::registerTypes();
+    Tp::enableDebug(false);
+    Tp::enableWarnings(false);
+
+    // The channels are registered on a private bus to not disturb (and be disturbed by) the session
+    PrivateBus bus;
+    const bool hasBus = bus.start();
+    if (!hasBus) {
+        qWarning() << "Running without a bus, the channel benchmarks are skipped";
+    }
+
+    ConnectionBenchmark benchmark(hasBus);
+    return QTest::qExec(&benchmark, argc, argv);
+}
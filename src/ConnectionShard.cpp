@@ -0,0 +1,84 @@
+#include "ConnectionShard.hpp"
+
+#include <QDBusError>
+#include <QDebug>
+#include <QThread>
+
+namespace SimpleCM {
+
+ConnectionShard::ConnectionShard(int index, QObject *parent)
+    : QObject(parent)
+    , m_index(index)
+    , m_busName(QStringLiteral("simplecm-shard-%1-%2").arg(reinterpret_cast<quintptr>(this)).arg(index))
+    , m_dbusConnection(m_busName)
+{
+}
+
+ConnectionShard::~ConnectionShard()
+{
+    stop();
+}
+
+int ConnectionShard::index() const
+{
+    return m_index;
+}
+
+QThread *ConnectionShard::workerThread() const
+{
+    return m_thread;
+}
+
+QDBusConnection ConnectionShard::dbusConnection() const
+{
+    return m_dbusConnection;
+}
+
+bool ConnectionShard::start()
+{
+    if (m_thread) {
+        return true;
+    }
+
+    m_dbusConnection = QDBusConnection::connectToBus(QDBusConnection::SessionBus, m_busName);
+    if (!m_dbusConnection.isConnected()) {
+        qWarning() << Q_FUNC_INFO << "Unable to connect shard" << m_index << "to the bus:"
+                   << m_dbusConnection.lastError().message();
+        QDBusConnection::disconnectFromBus(m_busName);
+        return false;
+    }
+
+    m_thread = new QThread();
+    m_thread->setObjectName(m_busName);
+    m_thread->start();
+    return true;
+}
+
+void ConnectionShard::stop()
+{
+    if (!m_thread) {
+        return;
+    }
+
+    m_thread->quit();
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+
+    QDBusConnection::disconnectFromBus(m_busName);
+}
+
+int ConnectionShard::connectionCount() const
+{
+    return m_connectionCount.load();
+}
+
+void ConnectionShard::addConnection(QObject *connection)
+{
+    m_connectionCount.ref();
+    connect(connection, &QObject::destroyed, this, [this]() {
+        m_connectionCount.deref();
+    }, Qt::DirectConnection);
+}
+
+} // SimpleCM
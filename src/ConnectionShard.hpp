@@ -0,0 +1,40 @@
+#ifndef SIMPLE_CONNECTION_SHARD_HPP
+#define SIMPLE_CONNECTION_SHARD_HPP
+
+#include <QAtomicInt>
+#include <QDBusConnection>
+#include <QObject>
+
+QT_FORWARD_DECLARE_CLASS(QThread)
+
+namespace SimpleCM {
+
+/* A worker thread with its own D-Bus connection and event loop for a subset of connections */
+class ConnectionShard : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ConnectionShard(int index, QObject *parent = nullptr);
+    ~ConnectionShard() override;
+
+    int index() const;
+    QThread *workerThread() const;
+    QDBusConnection dbusConnection() const;
+
+    bool start();
+    void stop();
+
+    int connectionCount() const;
+    void addConnection(QObject *connection);
+
+protected:
+    int m_index = 0;
+    QString m_busName;
+    QThread *m_thread = nullptr;
+    QDBusConnection m_dbusConnection;
+    QAtomicInt m_connectionCount;
+};
+
+} // SimpleCM
+
+#endif // SIMPLE_CONNECTION_SHARD_HPP
@@ -0,0 +1,208 @@
+#include "ContactNormalizer.hpp"
+
+#include <QMutexLocker>
+#include <QReadLocker>
+#include <QWriteLocker>
+
+namespace SimpleCM {
+
+static const int c_defaultCacheSize = 4096;
+static const int c_maxE164Digits = 15;
+
+static bool isPhoneSeparator(QChar c)
+{
+    return (c == QLatin1Char(' ')) || (c == QLatin1Char('-')) || (c == QLatin1Char('.'))
+            || (c == QLatin1Char('(')) || (c == QLatin1Char(')')) || (c == QLatin1Char('/'));
+}
+
+static bool isAsciiDigit(QChar c)
+{
+    return (c >= QLatin1Char('0')) && (c <= QLatin1Char('9'));
+}
+
+static bool looksLikePhoneNumber(const QString &identifier)
+{
+    bool hasDigits = false;
+    for (const QChar c : identifier) {
+        if (isAsciiDigit(c)) {
+            hasDigits = true;
+        } else if ((c != QLatin1Char('+')) && !isPhoneSeparator(c)) {
+            return false;
+        }
+    }
+    return hasDigits;
+}
+
+ContactNormalizer::ContactNormalizer(Steps steps)
+    : m_steps(steps)
+    , m_cache(c_defaultCacheSize)
+{
+}
+
+ContactNormalizer::Steps ContactNormalizer::steps() const
+{
+    QReadLocker locker(&m_settingsLock);
+    return m_steps;
+}
+
+void ContactNormalizer::setSteps(Steps steps)
+{
+    QWriteLocker locker(&m_settingsLock);
+    m_steps = steps;
+    clearCache();
+}
+
+QStringList ContactNormalizer::uriSchemes() const
+{
+    QReadLocker locker(&m_settingsLock);
+    return m_uriSchemes;
+}
+
+void ContactNormalizer::setUriSchemes(const QStringList &schemes)
+{
+    QWriteLocker locker(&m_settingsLock);
+    m_uriSchemes.clear();
+    for (const QString &scheme : schemes) {
+        m_uriSchemes << scheme.toLower();
+    }
+    clearCache();
+}
+
+QString ContactNormalizer::defaultCountryCode() const
+{
+    QReadLocker locker(&m_settingsLock);
+    return m_defaultCountryCode;
+}
+
+void ContactNormalizer::setDefaultCountryCode(const QString &code)
+{
+    QWriteLocker locker(&m_settingsLock);
+    m_defaultCountryCode = code;
+    if (m_defaultCountryCode.startsWith(QLatin1Char('+'))) {
+        m_defaultCountryCode.remove(0, 1);
+    }
+    clearCache();
+}
+
+void ContactNormalizer::addFilter(const Filter &filter)
+{
+    QWriteLocker locker(&m_settingsLock);
+    m_filters.append(filter);
+    clearCache();
+}
+
+int ContactNormalizer::cacheSize() const
+{
+    QMutexLocker locker(&m_cacheMutex);
+    return m_cache.maxCost();
+}
+
+void ContactNormalizer::setCacheSize(int size)
+{
+    QMutexLocker locker(&m_cacheMutex);
+    m_cache.setMaxCost(size);
+}
+
+void ContactNormalizer::clearCache()
+{
+    QMutexLocker locker(&m_cacheMutex);
+    m_cache.clear();
+}
+
+QString ContactNormalizer::normalize(const QString &identifier) const
+{
+    {
+        QMutexLocker locker(&m_cacheMutex);
+        const QString *cached = m_cache.object(identifier);
+        if (cached) {
+            return *cached;
+        }
+    }
+
+    // The settings can't change until the result is cached, so the cache never keeps a stale result
+    QReadLocker settingsLocker(&m_settingsLock);
+    const QString result = normalizeUncached(identifier);
+
+    QMutexLocker locker(&m_cacheMutex);
+    m_cache.insert(identifier, new QString(result));
+    return result;
+}
+
+QString ContactNormalizer::normalizeUncached(const QString &identifier) const
+{
+    QString result = identifier;
+    if (m_steps & TrimWhitespace) {
+        result = result.trimmed();
+    }
+    if (m_steps & StripUriScheme) {
+        result = stripUriScheme(result);
+    }
+    if ((m_steps & PhoneE164) && looksLikePhoneNumber(result)) {
+        result = toE164(result, m_defaultCountryCode);
+    }
+    if (m_steps & CaseFold) {
+        result = result.toCaseFolded();
+    }
+    for (const Filter &filter : m_filters) {
+        if (result.isEmpty()) {
+            break;
+        }
+        result = filter(result);
+    }
+    return result;
+}
+
+QString ContactNormalizer::stripUriScheme(const QString &identifier) const
+{
+    const int colon = identifier.indexOf(QLatin1Char(':'));
+    if (colon <= 0) {
+        return identifier;
+    }
+    if (!m_uriSchemes.contains(identifier.left(colon).toLower())) {
+        return identifier;
+    }
+    QString result = identifier.mid(colon + 1);
+    if (result.startsWith(QLatin1String("//"))) {
+        result.remove(0, 2);
+    }
+    return result;
+}
+
+QString ContactNormalizer::toE164(const QString &number, const QString &defaultCountryCode)
+{
+    QString digits;
+    digits.reserve(number.size());
+    bool international = false;
+    for (const QChar c : number) {
+        if (isAsciiDigit(c)) {
+            digits.append(c);
+        } else if ((c == QLatin1Char('+')) && digits.isEmpty() && !international) {
+            international = true;
+        } else if (!isPhoneSeparator(c)) {
+            return QString();
+        }
+    }
+
+    if (!international && digits.startsWith(QLatin1String("00"))) {
+        digits.remove(0, 2);
+        international = true;
+    }
+
+    if (!international) {
+        if (defaultCountryCode.isEmpty()) {
+            // A national number without a known country is kept as plain digits
+            return digits;
+        }
+        if (digits.startsWith(QLatin1Char('0'))) {
+            digits.remove(0, 1); // The trunk prefix
+        }
+        digits.prepend(defaultCountryCode);
+    }
+
+    if (digits.isEmpty() || (digits.size() > c_maxE164Digits)) {
+        return QString();
+    }
+    return QLatin1Char('+') + digits;
+}
+
+} // SimpleCM
@@ -0,0 +1,75 @@
+#ifndef SIMPLE_CONTACT_NORMALIZER_HPP
+#define SIMPLE_CONTACT_NORMALIZER_HPP
+
+#include <QCache>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QStringList>
+
+#include <functional>
+
+#include "simplecm_export.h"
+
+namespace SimpleCM {
+
+/* Maps the contact identifiers to their canonical form, memoizing the results in an LRU cache */
+class SIMPLECM_EXPORT ContactNormalizer
+{
+public:
+    enum Step {
+        NoSteps = 0,
+        TrimWhitespace = 1 << 0,
+        StripUriScheme = 1 << 1, // Only the uriSchemes()
+        PhoneE164 = 1 << 2, // Only the identifiers that look like a phone number
+        CaseFold = 1 << 3,
+    };
+    Q_DECLARE_FLAGS(Steps, Step)
+
+    // A custom step returns the normalized identifier or an empty string if the identifier is invalid
+    using Filter = std::function<QString(const QString &identifier)>;
+
+    // No steps by default: the host opts in to the normalization it needs
+    explicit ContactNormalizer(Steps steps = NoSteps);
+
+    Steps steps() const;
+    void setSteps(Steps steps);
+
+    QStringList uriSchemes() const;
+    void setUriSchemes(const QStringList &schemes);
+
+    // The country calling code (e.g. "49") for the numbers without an international prefix
+    QString defaultCountryCode() const;
+    void setDefaultCountryCode(const QString &code);
+
+    // The filters run after the built-in steps, in the order of addition
+    void addFilter(const Filter &filter);
+
+    int cacheSize() const;
+    void setCacheSize(int size);
+    void clearCache();
+
+    // Returns an empty string if the identifier is invalid; thread-safe
+    QString normalize(const QString &identifier) const;
+
+    static QString toE164(const QString &number, const QString &defaultCountryCode = QString());
+
+protected:
+    QString normalizeUncached(const QString &identifier) const;
+    QString stripUriScheme(const QString &identifier) const;
+
+    // The settings can be changed while the connection threads normalize
+    mutable QReadWriteLock m_settingsLock;
+    Steps m_steps;
+    QStringList m_uriSchemes;
+    QString m_defaultCountryCode;
+    QList<Filter> m_filters;
+
+    mutable QMutex m_cacheMutex;
+    mutable QCache<QString, QString> m_cache;
+};
+
+} // SimpleCM
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(SimpleCM::ContactNormalizer::Steps)
+
+#endif // SIMPLE_CONTACT_NORMALIZER_HPP
@@ -0,0 +1,184 @@
+#include "ContactsSnapshot.hpp"
+
+#include <QFile>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QVector>
+
+Q_LOGGING_CATEGORY(lcSimpleSnapshot, "simple.snapshot", QtWarningMsg)
+
+namespace SimpleCM {
+
+namespace {
+
+// The file is a header, an array of fixed-size entries (sorted by handle) and a UTF-8 string blob
+
+struct SnapshotHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 selfHandle;
+    quint32 entryCount;
+    quint32 stringsSize;
+};
+
+struct SnapshotEntry
+{
+    quint32 handle;
+    quint32 identifierOffset;
+    quint32 identifierSize;
+    quint32 statusOffset;
+    quint32 statusSize;
+    quint32 presenceType;
+    quint32 subscription;
+};
+
+static const quint32 c_snapshotMagic = 0x53434d53; // "SCMS"
+static const quint32 c_snapshotVersion = 1;
+static const quint32 c_noSubscription = 0xffffffff;
+
+} // namespace
+
+bool ContactsSnapshot::save(const QString &fileName) const
+{
+    QVector<SnapshotEntry> entries;
+    entries.reserve(handles.count());
+    QByteArray strings;
+
+    // Presence statuses are few, so they are stored once and shared by the entries
+    QHash<QString, SnapshotEntry> statusStrings;
+
+    for (auto it = handles.constBegin(); it != handles.constEnd(); ++it) {
+        SnapshotEntry entry;
+        entry.handle = it.key();
+
+        const QByteArray identifier = it.value().toUtf8();
+        entry.identifierOffset = static_cast<quint32>(strings.size());
+        entry.identifierSize = static_cast<quint32>(identifier.size());
+        strings.append(identifier);
+
+        const Tp::SimplePresence presence = presences.value(it.key());
+        auto status = statusStrings.find(presence.status);
+        if (status == statusStrings.end()) {
+            const QByteArray statusUtf8 = presence.status.toUtf8();
+            SnapshotEntry statusEntry;
+            statusEntry.statusOffset = static_cast<quint32>(strings.size());
+            statusEntry.statusSize = static_cast<quint32>(statusUtf8.size());
+            strings.append(statusUtf8);
+            status = statusStrings.insert(presence.status, statusEntry);
+        }
+        entry.statusOffset = status->statusOffset;
+        entry.statusSize = status->statusSize;
+        entry.presenceType = presence.type;
+        entry.subscription = subscriptions.value(it.key(), c_noSubscription);
+
+        entries.append(entry);
+    }
+
+    SnapshotHeader header;
+    header.magic = c_snapshotMagic;
+    header.version = c_snapshotVersion;
+    header.selfHandle = selfHandle;
+    header.entryCount = static_cast<quint32>(entries.count());
+    header.stringsSize = static_cast<quint32>(strings.size());
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(lcSimpleSnapshot) << "Unable to write" << fileName << file.errorString();
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(entries.constData()), entries.count() * sizeof(SnapshotEntry));
+    file.write(strings);
+
+    return file.commit();
+}
+
+bool ContactsSnapshot::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    if (fileSize < static_cast<qint64>(sizeof(SnapshotHeader))) {
+        qCWarning(lcSimpleSnapshot) << "Truncated snapshot" << fileName;
+        return false;
+    }
+
+    uchar *data = file.map(0, fileSize);
+    if (!data) {
+        qCWarning(lcSimpleSnapshot) << "Unable to map" << fileName << file.errorString();
+        return false;
+    }
+
+    const SnapshotHeader *header = reinterpret_cast<const SnapshotHeader *>(data);
+    const qint64 expectedSize = static_cast<qint64>(sizeof(SnapshotHeader))
+            + static_cast<qint64>(header->entryCount) * static_cast<qint64>(sizeof(SnapshotEntry))
+            + header->stringsSize;
+    if ((header->magic != c_snapshotMagic) || (header->version != c_snapshotVersion) || (expectedSize != fileSize)) {
+        qCWarning(lcSimpleSnapshot) << "Invalid snapshot" << fileName;
+        file.unmap(data);
+        return false;
+    }
+
+    const SnapshotEntry *entries = reinterpret_cast<const SnapshotEntry *>(data + sizeof(SnapshotHeader));
+    const char *strings = reinterpret_cast<const char *>(entries + header->entryCount);
+
+    QMap<uint, QString> newHandles;
+    Tp::SimpleContactPresences newPresences;
+    QHash<uint, uint> newSubscriptions;
+    newSubscriptions.reserve(static_cast<int>(header->entryCount));
+    QHash<quint32, QString> statuses;
+
+    bool valid = true;
+    uint previousHandle = 0;
+    for (quint32 i = 0; i < header->entryCount; ++i) {
+        const SnapshotEntry &entry = entries[i];
+        if ((entry.handle <= previousHandle)
+                || (quint64(entry.identifierOffset) + entry.identifierSize > header->stringsSize)
+                || (quint64(entry.statusOffset) + entry.statusSize > header->stringsSize)) {
+            valid = false;
+            break;
+        }
+        previousHandle = entry.handle;
+
+        // The entries are sorted, so appending with the end hint avoids the tree lookups
+        newHandles.insert(newHandles.constEnd(), entry.handle,
+                          QString::fromUtf8(strings + entry.identifierOffset, static_cast<int>(entry.identifierSize)));
+
+        if (entry.statusSize) {
+            auto status = statuses.find(entry.statusOffset);
+            if (status == statuses.end()) {
+                status = statuses.insert(entry.statusOffset,
+                                         QString::fromUtf8(strings + entry.statusOffset, static_cast<int>(entry.statusSize)));
+            }
+            Tp::SimplePresence presence;
+            presence.status = status.value();
+            presence.type = entry.presenceType;
+            newPresences.insert(newPresences.constEnd(), entry.handle, presence);
+        }
+
+        if (entry.subscription != c_noSubscription) {
+            newSubscriptions.insert(entry.handle, entry.subscription);
+        }
+    }
+    const uint newSelfHandle = header->selfHandle;
+
+    file.unmap(data);
+
+    if (!valid) {
+        qCWarning(lcSimpleSnapshot) << "Corrupted snapshot" << fileName;
+        return false;
+    }
+
+    selfHandle = newSelfHandle;
+    handles = newHandles;
+    presences = newPresences;
+    subscriptions = newSubscriptions;
+    return true;
+}
+
+} // SimpleCM
@@ -0,0 +1,26 @@
+#ifndef SIMPLE_CONTACTS_SNAPSHOT_HPP
+#define SIMPLE_CONTACTS_SNAPSHOT_HPP
+
+#include <TelepathyQt/Types>
+
+#include <QHash>
+#include <QMap>
+
+namespace SimpleCM {
+
+/* Roster and presence state of a connection, persisted to a memory-mappable file */
+class ContactsSnapshot
+{
+public:
+    bool save(const QString &fileName) const;
+    bool load(const QString &fileName);
+
+    uint selfHandle = 0;
+    QMap<uint, QString> handles;
+    Tp::SimpleContactPresences presences;
+    QHash<uint, uint> subscriptions;
+};
+
+} // SimpleCM
+
+#endif // SIMPLE_CONTACTS_SNAPSHOT_HPP
@@ -0,0 +1,36 @@
+#ifndef SIMPLE_MEMORY_USAGE_HPP
+#define SIMPLE_MEMORY_USAGE_HPP
+
+#include <QHash>
+#include <QMap>
+#include <QString>
+
+namespace SimpleCM {
+
+/* Approximate heap footprint of the containers (allocator overhead is not included) */
+namespace MemoryUsage {
+
+// The shared data header and the UTF-16 payload
+inline qint64 stringBytes(const QString &string)
+{
+    return static_cast<qint64>(sizeof(QArrayData)) + (string.size() + 1) * static_cast<qint64>(sizeof(QChar));
+}
+
+// The node and its bucket pointer
+template <typename Key, typename T>
+inline qint64 hashEntryBytes()
+{
+    return static_cast<qint64>(sizeof(QHashNode<Key, T>) + sizeof(void *));
+}
+
+template <typename Key, typename T>
+inline qint64 mapEntryBytes()
+{
+    return static_cast<qint64>(sizeof(QMapNode<Key, T>));
+}
+
+} // MemoryUsage
+
+} // SimpleCM
+
+#endif // SIMPLE_MEMORY_USAGE_HPP
@@ -3,11 +3,14 @@
 
 #include "Chat.hpp"
 
+#include <QMetaType>
+
 namespace SimpleCM {
 
 class SIMPLECM_EXPORT Message
 {
 public:
+    QString account; // self_id of the local account (empty for the default one)
     Chat chat;
     QString from;
     QString text;
@@ -15,4 +18,6 @@ public:
 
 } // SimpleCM
 
+Q_DECLARE_METATYPE(SimpleCM::Message)
+
 #endif // SIMPLE_MESSAGE_HPP
@@ -0,0 +1,134 @@
+#include "Metrics.hpp"
+
+#include <QtAlgorithms>
+
+namespace SimpleCM {
+
+Metrics::PaddedCounter Metrics::s_counters[Metrics::CounterCount];
+Metrics::PaddedGauge Metrics::s_gauges[Metrics::GaugeCount];
+QAtomicInteger<quint64> Metrics::s_histograms[Metrics::HistogramCount][Metrics::c_bucketCount];
+
+static const char *c_counterNames[Metrics::CounterCount] = {
+    "messages-in",
+    "messages-out",
+    "json-messages",
+    "channels-created",
+    "presence-updates",
+    "contacts-added",
+    "contacts-removed",
+    "channels-evicted",
+};
+
+static const char *c_gaugeNames[Metrics::GaugeCount] = {
+    "pending-messages",
+};
+
+static const char *c_histogramNames[Metrics::HistogramCount] = {
+    "json-decode-time",
+    "message-delivery-time",
+};
+
+int Metrics::bucketIndex(quint64 value)
+{
+    if (value < c_subBuckets) {
+        return static_cast<int>(value);
+    }
+    // The position of the highest bit selects the range, the next two bits the linear bucket in it
+    const int exponent = 63 - static_cast<int>(qCountLeadingZeroBits(value));
+    const int subBucket = static_cast<int>((value >> (exponent - 2)) & (c_subBuckets - 1));
+    return qMin((exponent - 1) * c_subBuckets + subBucket, c_bucketCount - 1);
+}
+
+quint64 Metrics::bucketLowerBound(int index)
+{
+    if (index < c_subBuckets) {
+        return static_cast<quint64>(index);
+    }
+    const int exponent = index / c_subBuckets + 1;
+    const quint64 subBucket = static_cast<quint64>(index % c_subBuckets);
+    return (c_subBuckets + subBucket) << (exponent - 2);
+}
+
+void Metrics::record(Histogram histogram, qint64 nanoseconds)
+{
+    s_histograms[histogram][bucketIndex(static_cast<quint64>(qMax<qint64>(0, nanoseconds)))].fetchAndAddRelaxed(1);
+}
+
+quint64 Metrics::counter(Counter counter)
+{
+    return s_counters[counter].value.load();
+}
+
+qint64 Metrics::gauge(Gauge gauge)
+{
+    return s_gauges[gauge].value.load();
+}
+
+quint64 Metrics::histogramCount(Histogram histogram)
+{
+    quint64 result = 0;
+    for (int i = 0; i < c_bucketCount; ++i) {
+        result += s_histograms[histogram][i].load();
+    }
+    return result;
+}
+
+quint64 Metrics::histogramPercentile(Histogram histogram, double percentile)
+{
+    quint64 buckets[c_bucketCount];
+    quint64 total = 0;
+    for (int i = 0; i < c_bucketCount; ++i) {
+        buckets[i] = s_histograms[histogram][i].load();
+        total += buckets[i];
+    }
+    if (!total) {
+        return 0;
+    }
+
+    const quint64 rank = qMax<quint64>(1, static_cast<quint64>(percentile / 100.0 * total + 0.5));
+    quint64 seen = 0;
+    for (int i = 0; i < c_bucketCount; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return bucketLowerBound(i);
+        }
+    }
+    return bucketLowerBound(c_bucketCount - 1);
+}
+
+QVariantMap Metrics::snapshot()
+{
+    QVariantMap result;
+    for (int i = 0; i < CounterCount; ++i) {
+        result.insert(QLatin1String(c_counterNames[i]), counter(static_cast<Counter>(i)));
+    }
+    for (int i = 0; i < GaugeCount; ++i) {
+        result.insert(QLatin1String(c_gaugeNames[i]), gauge(static_cast<Gauge>(i)));
+    }
+    for (int i = 0; i < HistogramCount; ++i) {
+        const Histogram histogram = static_cast<Histogram>(i);
+        QVariantMap summary;
+        summary.insert(QStringLiteral("count"), histogramCount(histogram));
+        summary.insert(QStringLiteral("p50"), histogramPercentile(histogram, 50));
+        summary.insert(QStringLiteral("p90"), histogramPercentile(histogram, 90));
+        summary.insert(QStringLiteral("p99"), histogramPercentile(histogram, 99));
+        summary.insert(QStringLiteral("max"), histogramPercentile(histogram, 100));
+        result.insert(QLatin1String(c_histogramNames[i]), summary);
+    }
+    return result;
+}
+
+void Metrics::reset()
+{
+    for (int i = 0; i < CounterCount; ++i) {
+        s_counters[i].value.store(0);
+    }
+    // The gauges reflect the live state and are not reset
+    for (int i = 0; i < HistogramCount; ++i) {
+        for (int j = 0; j < c_bucketCount; ++j) {
+            s_histograms[i][j].store(0);
+        }
+    }
+}
+
+} // SimpleCM
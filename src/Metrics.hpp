@@ -0,0 +1,92 @@
+#ifndef SIMPLE_METRICS_HPP
+#define SIMPLE_METRICS_HPP
+
+#include <QAtomicInteger>
+#include <QVariantMap>
+
+#include <chrono>
+
+namespace SimpleCM {
+
+/* A process-wide registry of relaxed atomic counters and log-linear latency histograms */
+class Metrics
+{
+public:
+    enum Counter {
+        MessagesIn,
+        MessagesOut,
+        JsonMessages,
+        ChannelsCreated,
+        PresenceUpdates,
+        ContactsAdded,
+        ContactsRemoved,
+        ChannelsEvicted,
+        CounterCount
+    };
+
+    enum Gauge {
+        PendingMessages,
+        GaugeCount
+    };
+
+    enum Histogram {
+        JsonDecodeTime,
+        MessageDeliveryTime, // From Service::addMessage() to the MessageReceived emission
+        HistogramCount
+    };
+
+    static void increment(Counter counter, quint64 value = 1)
+    {
+        s_counters[counter].value.fetchAndAddRelaxed(value);
+    }
+
+    static void adjust(Gauge gauge, qint64 delta)
+    {
+        s_gauges[gauge].value.fetchAndAddRelaxed(delta);
+    }
+
+    // Nanoseconds of a monotonic clock
+    static qint64 now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void record(Histogram histogram, qint64 nanoseconds);
+    static void recordSince(Histogram histogram, qint64 start)
+    {
+        record(histogram, now() - start);
+    }
+
+    static quint64 counter(Counter counter);
+    static qint64 gauge(Gauge gauge);
+    static quint64 histogramCount(Histogram histogram);
+    // The lower bound of the bucket holding the percentile, in nanoseconds
+    static quint64 histogramPercentile(Histogram histogram, double percentile);
+
+    static QVariantMap snapshot();
+    static void reset();
+
+    // 4 linear buckets per power of two, up to 2^43 ns (about 2.4 hours)
+    static const int c_subBuckets = 4;
+    static const int c_bucketCount = 42 * c_subBuckets;
+
+    static int bucketIndex(quint64 value);
+    static quint64 bucketLowerBound(int index);
+
+protected:
+    // Padded to keep the counters updated from different threads on separate cache lines
+    struct alignas(64) PaddedCounter {
+        QAtomicInteger<quint64> value;
+    };
+    struct alignas(64) PaddedGauge {
+        QAtomicInteger<qint64> value;
+    };
+
+    static PaddedCounter s_counters[CounterCount];
+    static PaddedGauge s_gauges[GaugeCount];
+    static QAtomicInteger<quint64> s_histograms[HistogramCount][c_bucketCount];
+};
+
+} // SimpleCM
+
+#endif // SIMPLE_METRICS_HPP
@@ -0,0 +1,17 @@
+#include "MetricsAdaptor.hpp"
+
+#include "Metrics.hpp"
+
+namespace SimpleCM {
+
+MetricsAdaptor::MetricsAdaptor(QObject *parent)
+    : QDBusAbstractAdaptor(parent)
+{
+}
+
+QVariantMap MetricsAdaptor::GetMetrics() const
+{
+    return Metrics::snapshot();
+}
+
+} // SimpleCM
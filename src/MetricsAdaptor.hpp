@@ -0,0 +1,23 @@
+#ifndef SIMPLE_METRICS_ADAPTOR_HPP
+#define SIMPLE_METRICS_ADAPTOR_HPP
+
+#include <QDBusAbstractAdaptor>
+#include <QVariantMap>
+
+namespace SimpleCM {
+
+/* A read-only debug D-Bus interface to the Metrics registry */
+class MetricsAdaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "SimpleCM.Debug.Metrics")
+public:
+    explicit MetricsAdaptor(QObject *parent);
+
+public slots:
+    QVariantMap GetMetrics() const;
+};
+
+} // SimpleCM
+
+#endif // SIMPLE_METRICS_ADAPTOR_HPP
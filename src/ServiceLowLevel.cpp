@@ -3,11 +3,14 @@
 #include "Chat.hpp"
 #include "connection.h"
 #include "JsonUtils.hpp"
+#include "Metrics.hpp"
 #include "protocol.h"
 #include "textchannel.h"
+#include "TrafficRecorder.hpp"
 
 #include <TelepathyQt/BaseConnectionManager>
 #include <TelepathyQt/BaseProtocol>
+#include <TelepathyQt/Constants>
 
 namespace SimpleCM {
 
@@ -23,27 +26,67 @@ Tp::BaseConnectionManagerPtr ServiceLowLevel::getConnectionManager()
 
 void ServiceLowLevel::sendJsonMessage(const Chat &target, const QByteArray &json)
 {
+    sendJsonMessage(QString(), target, json);
+}
+
+void ServiceLowLevel::sendJsonMessage(const QString &account, const Chat &target, const QByteArray &json)
+{
+    if (m_d->recorder) {
+        m_d->recorder->recordJsonMessage(account, target, json);
+    }
+
     SimpleProtocolPtr protocol = SimpleProtocolPtr::dynamicCast(m_d->baseProtocol);
     if (!protocol) {
         return;
     }
 
-    SimpleConnectionPtr connection = protocol->getConnection();
+    SimpleConnectionPtr connection = protocol->getConnection(account);
     if (!connection) {
         return;
     }
 
-    SimpleTextChannelPtr textChannel = connection->ensureTextChannel(target);
-    if (!textChannel) {
-        return;
-    }
-
+    const qint64 decodeStart = Metrics::now();
     Tp::MessagePartList partList = JsonUtils::messageFromJson(json);
+    Metrics::recordSince(Metrics::JsonDecodeTime, decodeStart);
     if (partList.isEmpty()) {
         return;
     }
+    Metrics::increment(Metrics::JsonMessages);
+
+    connection->invoke([connection, target, partList]() {
+        SimpleTextChannelPtr textChannel = connection->ensureTextChannel(target);
+        if (!textChannel) {
+            return;
+        }
+
+        // The JSON sender is not resolved to a handle, so it is not referenced by the message
+        textChannel->addIncomingMessage(partList, /* senderHandle */ 0);
+        Metrics::increment(Metrics::MessagesIn);
+    });
+}
+
+Tp::BaseConnectionPtr ServiceLowLevel::createConnection(const QVariantMap &parameters, Tp::DBusError *error)
+{
+    if (!m_d->baseProtocol) {
+        error->set(TP_QT_ERROR_NOT_AVAILABLE, QLatin1String("The service is not prepared"));
+        return Tp::BaseConnectionPtr();
+    }
+
+    Tp::BaseConnectionPtr connection = m_d->baseProtocol->createConnection(parameters, error);
+    if (!connection || error->isValid()) {
+        return Tp::BaseConnectionPtr();
+    }
+
+    if (!connection->registerObject(error)) {
+        return Tp::BaseConnectionPtr();
+    }
+
+    SimpleConnectionPtr simpleConnection = SimpleConnectionPtr::dynamicCast(connection);
+    simpleConnection->invoke([simpleConnection, error]() {
+        simpleConnection->connectCallback(error);
+    }, /* blocking */ true);
 
-    textChannel->addReceivedMessage(partList);
+    return connection;
 }
 
 ServiceLowLevel::ServiceLowLevel(QObject *parent)
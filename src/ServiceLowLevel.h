@@ -3,6 +3,7 @@
 
 #include <QObject>
 
+#include <TelepathyQt/DBusError>
 #include <TelepathyQt/ServiceTypes>
 
 namespace SimpleCM {
@@ -18,6 +19,10 @@ public:
     Tp::BaseConnectionManagerPtr getConnectionManager();
 
     void sendJsonMessage(const Chat &target, const QByteArray &json);
+    void sendJsonMessage(const QString &account, const Chat &target, const QByteArray &json);
+
+    // Creates, registers and connects a connection without a Telepathy client (for headless tools)
+    Tp::BaseConnectionPtr createConnection(const QVariantMap &parameters, Tp::DBusError *error);
 
 protected:
     explicit ServiceLowLevel(QObject *parent = nullptr);
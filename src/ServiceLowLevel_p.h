@@ -5,6 +5,8 @@
 
 namespace SimpleCM {
 
+class TrafficRecorder;
+
 class ServiceLowLevelPrivate
 {
 public:
@@ -15,6 +17,7 @@ public:
 
     Tp::BaseProtocolPtr baseProtocol;
     Tp::BaseConnectionManagerPtr connectionManager;
+    TrafficRecorder *recorder = nullptr;
 };
 
 } // SimpleCM
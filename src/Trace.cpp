@@ -0,0 +1,146 @@
+#include "Trace.hpp"
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+#include <chrono>
+
+Q_LOGGING_CATEGORY(lcSimpleConnection, "simple.connection", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcSimpleProtocol, "simple.protocol", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcSimpleChannel, "simple.channel", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcSimpleTelepathy, "simple.telepathy", QtWarningMsg)
+
+namespace SimpleCM {
+
+namespace {
+
+struct TraceEvent
+{
+    const char *name;
+    Qt::HANDLE thread;
+    qint64 start; // ns
+    qint64 end; // ns
+};
+
+struct TraceBuffer
+{
+    explicit TraceBuffer(int capacity)
+        : events(capacity, TraceEvent { nullptr, nullptr, 0, 0 })
+        , slots(events.data())
+        , capacity(static_cast<quint64>(capacity))
+    {
+    }
+
+    QVector<TraceEvent> events;
+    TraceEvent *slots; // Written by record() without touching the vector
+    quint64 capacity;
+    QAtomicInteger<quint64> nextEvent;
+};
+
+// record() loads the buffer once, so a buffer replaced by start() can still be written to.
+// The replaced buffers are never freed; start() is a debugging control called a few times per process.
+QAtomicPointer<TraceBuffer> s_buffer;
+QVector<TraceBuffer *> s_retiredBuffers;
+QMutex s_controlMutex;
+
+} // namespace
+
+QAtomicInt Trace::s_running;
+
+qint64 TraceScope::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::start(int capacity)
+{
+    QMutexLocker locker(&s_controlMutex);
+    s_running.storeRelease(0);
+    TraceBuffer *previous = s_buffer.fetchAndStoreOrdered(new TraceBuffer(qMax(1, capacity)));
+    if (previous) {
+        s_retiredBuffers.append(previous);
+    }
+    s_running.storeRelease(1);
+}
+
+void Trace::stop()
+{
+    QMutexLocker locker(&s_controlMutex);
+    s_running.storeRelease(0);
+}
+
+void Trace::record(const char *name, qint64 start, qint64 end)
+{
+    if (!isRunning()) {
+        return;
+    }
+    TraceBuffer *buffer = s_buffer.loadAcquire();
+    if (!buffer) {
+        return;
+    }
+    const quint64 index = buffer->nextEvent.fetchAndAddRelaxed(1) % buffer->capacity;
+    TraceEvent &event = buffer->slots[index];
+    event.name = name;
+    event.thread = QThread::currentThreadId();
+    event.start = start;
+    event.end = end;
+}
+
+bool Trace::writeChromeTrace(const QString &fileName)
+{
+    QMutexLocker locker(&s_controlMutex);
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    const TraceBuffer *buffer = s_buffer.loadAcquire();
+    const quint64 capacity = buffer ? buffer->capacity : 1;
+    const quint64 recorded = buffer ? buffer->nextEvent.load() : 0;
+    const quint64 first = recorded > capacity ? recorded - capacity : 0;
+
+    // The formatting happens only here, far from the traced code
+    QHash<Qt::HANDLE, int> threadIds;
+    qint64 origin = -1;
+    for (quint64 i = first; i < recorded; ++i) {
+        const TraceEvent &event = buffer->slots[i % capacity];
+        if (event.name && ((origin < 0) || (event.start < origin))) {
+            origin = event.start;
+        }
+    }
+
+    file.write("{\"traceEvents\":[\n");
+    bool firstEvent = true;
+    for (quint64 i = first; i < recorded; ++i) {
+        const TraceEvent &event = buffer->slots[i % capacity];
+        if (!event.name) {
+            continue;
+        }
+        auto thread = threadIds.find(event.thread);
+        if (thread == threadIds.end()) {
+            thread = threadIds.insert(event.thread, threadIds.count() + 1);
+        }
+
+        QByteArray line = firstEvent ? QByteArray() : QByteArrayLiteral(",\n");
+        firstEvent = false;
+        line += "{\"name\":\"";
+        line += event.name;
+        line += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+        line += QByteArray::number(thread.value());
+        line += ",\"ts\":";
+        line += QByteArray::number((event.start - origin) / 1000.0, 'f', 3);
+        line += ",\"dur\":";
+        line += QByteArray::number((event.end - event.start) / 1000.0, 'f', 3);
+        line += "}";
+        file.write(line);
+    }
+    file.write("\n]}\n");
+
+    return file.error() == QFile::NoError;
+}
+
+} // SimpleCM
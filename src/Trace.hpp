@@ -0,0 +1,79 @@
+#ifndef SIMPLE_TRACE_HPP
+#define SIMPLE_TRACE_HPP
+
+#include <QAtomicInt>
+#include <QLoggingCategory>
+
+#include "simplecm_export.h"
+
+Q_DECLARE_LOGGING_CATEGORY(lcSimpleConnection)
+Q_DECLARE_LOGGING_CATEGORY(lcSimpleProtocol)
+Q_DECLARE_LOGGING_CATEGORY(lcSimpleChannel)
+Q_DECLARE_LOGGING_CATEGORY(lcSimpleTelepathy)
+
+// The trace messages are compiled only into the builds with SIMPLECM_ENABLE_TRACE (Debug by default).
+// In the other builds the message (and its arguments) is never evaluated.
+#ifdef SIMPLECM_ENABLE_TRACE
+#define SIMPLECM_TRACE(category) qCDebug(category)
+#else
+#define SIMPLECM_TRACE(category) while (false) qCDebug(category)
+#endif
+
+#define SIMPLECM_TRACE_CONCAT_IMPL(a, b) a##b
+#define SIMPLECM_TRACE_CONCAT(a, b) SIMPLECM_TRACE_CONCAT_IMPL(a, b)
+
+// Records the duration of the enclosing scope into the binary trace (if it is running).
+// The name must be a string literal: only the pointer is stored.
+#define SIMPLECM_TRACE_SCOPE(name) \
+    SimpleCM::TraceScope SIMPLECM_TRACE_CONCAT(simplecmTraceScope, __LINE__)(name)
+
+namespace SimpleCM {
+
+/* A lock-free ring buffer of the scope durations, written as Chrome trace JSON on demand */
+class SIMPLECM_EXPORT Trace
+{
+public:
+    static bool isRunning()
+    {
+        return s_running.loadAcquire();
+    }
+
+    // Starts a new trace keeping the latest capacity events
+    static void start(int capacity = 65536);
+    static void stop();
+
+    // Writes the recorded events in the Chrome trace format (chrome://tracing, Perfetto)
+    static bool writeChromeTrace(const QString &fileName);
+
+    static void record(const char *name, qint64 start, qint64 end);
+
+protected:
+    static QAtomicInt s_running;
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name)
+        : m_name(Trace::isRunning() ? name : nullptr)
+        , m_start(m_name ? now() : 0)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (m_name) {
+            Trace::record(m_name, m_start, now());
+        }
+    }
+
+    static qint64 now();
+
+private:
+    const char *m_name;
+    qint64 m_start;
+};
+
+} // SimpleCM
+
+#endif // SIMPLE_TRACE_HPP
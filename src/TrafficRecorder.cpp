@@ -0,0 +1,253 @@
+#include "TrafficRecorder.hpp"
+
+#include "Message.hpp"
+
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(lcSimpleTraffic, "simple.traffic", QtWarningMsg)
+
+namespace SimpleCM {
+
+static const quint32 c_trafficMagic = 0x53434d54; // "SCMT"
+static const quint16 c_trafficVersion = 2;
+
+static void writeString(QDataStream &stream, const QString &string)
+{
+    stream << string.toUtf8();
+}
+
+static QString readString(QDataStream &stream)
+{
+    QByteArray utf8;
+    stream >> utf8;
+    return QString::fromUtf8(utf8);
+}
+
+static void writeChat(QDataStream &stream, const Chat &chat)
+{
+    stream << static_cast<quint8>(chat.type);
+    writeString(stream, chat.identifier);
+}
+
+static Chat readChat(QDataStream &stream)
+{
+    quint8 type = Chat::Invalid;
+    stream >> type;
+    return Chat(readString(stream), static_cast<Chat::Type>(type));
+}
+
+TrafficRecorder::~TrafficRecorder()
+{
+    close();
+}
+
+bool TrafficRecorder::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCWarning(lcSimpleTraffic) << "Unable to open" << fileName << m_file.errorString();
+        return false;
+    }
+
+    m_stream.setDevice(&m_file);
+    m_stream.setVersion(QDataStream::Qt_5_0);
+    m_stream << c_trafficMagic << c_trafficVersion;
+
+    m_lastTimestamp = 0;
+    m_timer.start();
+    return true;
+}
+
+void TrafficRecorder::close()
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+    m_stream.setDevice(nullptr);
+    m_file.close();
+}
+
+bool TrafficRecorder::isRecording() const
+{
+    return m_file.isOpen();
+}
+
+void TrafficRecorder::recordMessage(const Message &message)
+{
+    TrafficRecord record;
+    record.type = TrafficRecord::AddMessage;
+    record.account = message.account;
+    record.chat = message.chat;
+    record.identifier = message.from;
+    record.text = message.text;
+    writeRecord(record);
+}
+
+void TrafficRecorder::recordContactPresence(const QString &account, const QString &identifier, const QString &presence)
+{
+    TrafficRecord record;
+    record.type = TrafficRecord::SetContactPresence;
+    record.account = account;
+    record.identifier = identifier;
+    record.text = presence;
+    writeRecord(record);
+}
+
+void TrafficRecorder::recordContactList(const QString &account, const QStringList &list)
+{
+    TrafficRecord record;
+    record.type = TrafficRecord::SetContactList;
+    record.account = account;
+    record.contacts = list;
+    writeRecord(record);
+}
+
+void TrafficRecorder::recordJsonMessage(const QString &account, const Chat &target, const QByteArray &json)
+{
+    TrafficRecord record;
+    record.type = TrafficRecord::SendJsonMessage;
+    record.account = account;
+    record.chat = target;
+    record.json = json;
+    writeRecord(record);
+}
+
+void TrafficRecorder::writeRecord(const TrafficRecord &record)
+{
+    if (!isRecording()) {
+        return;
+    }
+
+    // Timestamps are stored as a delta to the previous record to keep the file compact
+    const qint64 timestamp = m_timer.nsecsElapsed() / 1000;
+    const quint32 delta = static_cast<quint32>(qMin<qint64>(timestamp - m_lastTimestamp, 0xffffffff));
+    m_lastTimestamp += delta;
+
+    m_stream << static_cast<quint8>(record.type) << delta;
+    writeString(m_stream, record.account);
+
+    switch (record.type) {
+    case TrafficRecord::AddMessage:
+        writeChat(m_stream, record.chat);
+        writeString(m_stream, record.identifier);
+        writeString(m_stream, record.text);
+        break;
+    case TrafficRecord::SetContactPresence:
+        writeString(m_stream, record.identifier);
+        writeString(m_stream, record.text);
+        break;
+    case TrafficRecord::SetContactList:
+        m_stream << static_cast<quint32>(record.contacts.count());
+        for (const QString &contact : record.contacts) {
+            writeString(m_stream, contact);
+        }
+        break;
+    case TrafficRecord::SendJsonMessage:
+        writeChat(m_stream, record.chat);
+        m_stream << record.json;
+        break;
+    case TrafficRecord::Invalid:
+        break;
+    }
+}
+
+bool TrafficReader::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qCWarning(lcSimpleTraffic) << "Unable to open" << fileName << m_file.errorString();
+        return false;
+    }
+
+    m_stream.setDevice(&m_file);
+    m_stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    m_stream >> magic >> version;
+    if ((magic != c_trafficMagic) || (version != c_trafficVersion)) {
+        qCWarning(lcSimpleTraffic) << "Unsupported traffic file" << fileName;
+        close();
+        return false;
+    }
+
+    m_lastTimestamp = 0;
+    return true;
+}
+
+void TrafficReader::close()
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+    m_stream.setDevice(nullptr);
+    m_file.close();
+}
+
+bool TrafficReader::atEnd() const
+{
+    return !m_file.isOpen() || m_stream.atEnd() || (m_stream.status() != QDataStream::Ok);
+}
+
+TrafficRecord TrafficReader::readNext()
+{
+    TrafficRecord record;
+    if (atEnd()) {
+        return record;
+    }
+
+    quint8 type = TrafficRecord::Invalid;
+    quint32 delta = 0;
+    m_stream >> type >> delta;
+    m_lastTimestamp += delta;
+    record.timestamp = m_lastTimestamp;
+    record.account = readString(m_stream);
+
+    switch (type) {
+    case TrafficRecord::AddMessage:
+        record.chat = readChat(m_stream);
+        record.identifier = readString(m_stream);
+        record.text = readString(m_stream);
+        break;
+    case TrafficRecord::SetContactPresence:
+        record.identifier = readString(m_stream);
+        record.text = readString(m_stream);
+        break;
+    case TrafficRecord::SetContactList: {
+        quint32 count = 0;
+        m_stream >> count;
+        // Each contact takes at least its length, a corrupted count must not reserve gigabytes
+        if (count > m_file.bytesAvailable() / static_cast<qint64>(sizeof(quint32))) {
+            qCWarning(lcSimpleTraffic) << "Invalid contact count" << count;
+            m_stream.setStatus(QDataStream::ReadCorruptData);
+            return record;
+        }
+        record.contacts.reserve(static_cast<int>(count));
+        for (quint32 i = 0; (i < count) && (m_stream.status() == QDataStream::Ok); ++i) {
+            record.contacts << readString(m_stream);
+        }
+    }
+        break;
+    case TrafficRecord::SendJsonMessage:
+        record.chat = readChat(m_stream);
+        m_stream >> record.json;
+        break;
+    default:
+        qCWarning(lcSimpleTraffic) << "Unknown record type" << type;
+        m_stream.setStatus(QDataStream::ReadCorruptData);
+        return record;
+    }
+
+    if (m_stream.status() != QDataStream::Ok) {
+        return record;
+    }
+
+    record.type = static_cast<TrafficRecord::Type>(type);
+    return record;
+}
+
+} // SimpleCM
@@ -0,0 +1,81 @@
+#ifndef SIMPLE_TRAFFIC_RECORDER_HPP
+#define SIMPLE_TRAFFIC_RECORDER_HPP
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+
+#include "Chat.hpp"
+
+namespace SimpleCM {
+
+class Message;
+
+class SIMPLECM_EXPORT TrafficRecord
+{
+public:
+    enum Type : quint8 {
+        Invalid,
+        AddMessage,
+        SetContactPresence,
+        SetContactList,
+        SendJsonMessage,
+    };
+
+    Type type = Invalid;
+    qint64 timestamp = 0; // Microseconds since the recording start
+    QString account; // Empty for the default account
+
+    Chat chat; // AddMessage, SendJsonMessage
+    QString identifier; // AddMessage (sender), SetContactPresence (contact)
+    QString text; // AddMessage (text), SetContactPresence (presence)
+    QStringList contacts; // SetContactList
+    QByteArray json; // SendJsonMessage
+};
+
+/* Captures the Service host calls into a compact binary file */
+class SIMPLECM_EXPORT TrafficRecorder
+{
+public:
+    TrafficRecorder() = default;
+    ~TrafficRecorder();
+
+    bool open(const QString &fileName);
+    void close();
+    bool isRecording() const;
+
+    void recordMessage(const Message &message);
+    void recordContactPresence(const QString &account, const QString &identifier, const QString &presence);
+    void recordContactList(const QString &account, const QStringList &list);
+    void recordJsonMessage(const QString &account, const Chat &target, const QByteArray &json);
+
+protected:
+    void writeRecord(const TrafficRecord &record);
+
+    QFile m_file;
+    QDataStream m_stream;
+    QElapsedTimer m_timer;
+    qint64 m_lastTimestamp = 0;
+};
+
+class SIMPLECM_EXPORT TrafficReader
+{
+public:
+    TrafficReader() = default;
+
+    bool open(const QString &fileName);
+    void close();
+
+    bool atEnd() const;
+    TrafficRecord readNext();
+
+protected:
+    QFile m_file;
+    QDataStream m_stream;
+    qint64 m_lastTimestamp = 0;
+};
+
+} // SimpleCM
+
+#endif // SIMPLE_TRAFFIC_RECORDER_HPP
@@ -0,0 +1,356 @@
+#include "TrafficReplayer.hpp"
+
+#include "ContactNormalizer.hpp"
+#include "JsonUtils.hpp"
+#include "Message.hpp"
+#include "service.h"
+#include "ServiceLowLevel.h"
+
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/Types>
+
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QTimer>
+
+#include <algorithm>
+#include <cmath>
+
+namespace SimpleCM {
+
+// Records replayed per event loop iteration in the "as fast as possible" mode
+static const int c_fastBatchSize = 64;
+
+double TrafficReplayReport::throughput() const
+{
+    if (elapsed <= 0) {
+        return 0;
+    }
+    return records * 1000000.0 / elapsed;
+}
+
+qint64 TrafficReplayReport::latencyPercentile(double percentile) const
+{
+    return TrafficReplayReport::percentile(latencies, percentile);
+}
+
+qint64 TrafficReplayReport::percentile(QVector<qint64> values, double percentile)
+{
+    if (values.isEmpty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+
+    int index = static_cast<int>(std::ceil(percentile / 100.0 * values.count())) - 1;
+    index = qBound(0, index, values.count() - 1);
+    return values.at(index);
+}
+
+TrafficReplayer::TrafficReplayer(Service *service, QObject *parent)
+    : QObject(parent)
+    , m_service(service)
+    , m_replayTimer(new QTimer(this))
+    , m_drainTimer(new QTimer(this))
+{
+    m_replayTimer->setSingleShot(true);
+    m_replayTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_replayTimer, &QTimer::timeout, this, &TrafficReplayer::replayNext);
+
+    m_drainTimer->setSingleShot(true);
+    connect(m_drainTimer, &QTimer::timeout, this, &TrafficReplayer::finish);
+}
+
+double TrafficReplayer::speed() const
+{
+    return m_speed;
+}
+
+void TrafficReplayer::setSpeed(double speed)
+{
+    m_speed = qMax(0.0, speed);
+}
+
+int TrafficReplayer::drainTimeout() const
+{
+    return m_drainTimeout;
+}
+
+void TrafficReplayer::setDrainTimeout(int msecs)
+{
+    m_drainTimeout = msecs;
+}
+
+bool TrafficReplayer::isRunning() const
+{
+    return m_running;
+}
+
+TrafficReplayReport TrafficReplayer::report() const
+{
+    return m_report;
+}
+
+bool TrafficReplayer::start(const QString &fileName)
+{
+    if (m_running || !m_service) {
+        return false;
+    }
+
+    if (!m_reader.open(fileName)) {
+        return false;
+    }
+
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    bus.connect(QString(), QString(), TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES,
+                QLatin1String("MessageReceived"), this, SLOT(onMessageReceived(QDBusMessage)));
+    bus.connect(QString(), QString(), TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE,
+                QLatin1String("PresencesChanged"), this, SLOT(onPresencesChanged(QDBusMessage)));
+
+    m_report = TrafficReplayReport();
+    m_pendingTokens.clear();
+    m_pendingMessages.clear();
+    m_pendingPresences.clear();
+    m_contactIdentifiers.clear();
+    m_pendingCount = 0;
+    m_running = true;
+    m_draining = false;
+
+    m_nextRecord = m_reader.readNext();
+    m_timer.start();
+    m_replayTimer->start(0);
+
+    return true;
+}
+
+void TrafficReplayer::replayNext()
+{
+    int batchSize = 0;
+    while (m_nextRecord.type != TrafficRecord::Invalid) {
+        if (m_speed > 0) {
+            const qint64 due = static_cast<qint64>(m_nextRecord.timestamp / m_speed);
+            const qint64 now = m_timer.nsecsElapsed() / 1000;
+            if (due > now) {
+                m_replayTimer->start(static_cast<int>((due - now) / 1000));
+                return;
+            }
+        } else if (batchSize == c_fastBatchSize) {
+            // Let the event loop deliver the D-Bus traffic between the batches
+            m_replayTimer->start(0);
+            return;
+        }
+
+        replayRecord(m_nextRecord);
+        ++batchSize;
+        m_nextRecord = m_reader.readNext();
+    }
+
+    m_report.elapsed = m_timer.nsecsElapsed() / 1000;
+    m_reader.close();
+    startDrain();
+}
+
+void TrafficReplayer::replayRecord(const TrafficRecord &record)
+{
+    const qint64 now = m_timer.nsecsElapsed() / 1000;
+    ++m_report.records;
+    // The records of the default account go to the service's own account
+    const QString account = record.account.isEmpty() ? m_service->selfContactIdentifier() : record.account;
+
+    switch (record.type) {
+    case TrafficRecord::AddMessage: {
+        Message message;
+        message.account = account;
+        message.chat = record.chat;
+        message.from = record.identifier;
+        message.text = record.text;
+
+        ++m_report.messages;
+        // The room messages are from the message.from member
+        const QString sender = (record.chat.type == Chat::Room) ? record.identifier : record.chat.identifier;
+        expectMessage(QString(), sender, now);
+        m_service->addMessage(message);
+    }
+        break;
+    case TrafficRecord::SetContactPresence:
+        ++m_report.presences;
+        // The new contacts also get an "unknown" presence on the way, the status tells them apart
+        ++m_pendingCount;
+        m_pendingPresences[qMakePair(normalizedIdentifier(record.identifier), record.text)].enqueue(now);
+        m_service->setContactPresence(account, record.identifier, record.text);
+        break;
+    case TrafficRecord::SetContactList:
+        ++m_report.contactLists;
+        m_service->setContactList(account, record.contacts);
+        break;
+    case TrafficRecord::SendJsonMessage: {
+        ++m_report.jsonMessages;
+        // The JSON header tells the sender (and possibly the token) of the message
+        const Tp::MessagePartList parts = JsonUtils::messageFromJson(record.json);
+        if (!parts.isEmpty()) {
+            const Tp::MessagePart &header = parts.constFirst();
+            expectMessage(header.value(QLatin1String("message-token")).variant().toString(),
+                          header.value(QLatin1String("message-sender-id")).variant().toString(), now);
+        }
+        m_service->lowLevel()->sendJsonMessage(account, record.chat, record.json);
+    }
+        break;
+    case TrafficRecord::Invalid:
+        break;
+    }
+}
+
+void TrafficReplayer::expectMessage(const QString &token, const QString &sender, qint64 injectedAt)
+{
+    ++m_pendingCount;
+    if (!token.isEmpty() && !m_pendingTokens.contains(token)) {
+        m_pendingTokens.insert(token, injectedAt);
+    } else {
+        m_pendingMessages[normalizedIdentifier(sender)].enqueue(injectedAt);
+    }
+}
+
+void TrafficReplayer::observe(QQueue<qint64> *pending, qint64 observedAt)
+{
+    if (!m_running || !pending || pending->isEmpty()) {
+        return;
+    }
+
+    observe(pending->dequeue(), observedAt);
+}
+
+void TrafficReplayer::observe(qint64 injectedAt, qint64 observedAt)
+{
+    if (!m_running) {
+        return;
+    }
+
+    m_report.latencies.append(observedAt - injectedAt);
+    --m_pendingCount;
+
+    if (m_draining && (m_pendingCount == 0)) {
+        finish();
+    }
+}
+
+void TrafficReplayer::startDrain()
+{
+    if (m_pendingCount == 0) {
+        finish();
+        return;
+    }
+
+    m_draining = true;
+    m_drainTimer->start(m_drainTimeout);
+}
+
+void TrafficReplayer::finish()
+{
+    if (!m_running) {
+        return;
+    }
+
+    m_drainTimer->stop();
+    m_running = false;
+    m_draining = false;
+    m_report.unobserved = m_pendingCount;
+
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    bus.disconnect(QString(), QString(), TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES,
+                   QLatin1String("MessageReceived"), this, SLOT(onMessageReceived(QDBusMessage)));
+    bus.disconnect(QString(), QString(), TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE,
+                   QLatin1String("PresencesChanged"), this, SLOT(onPresencesChanged(QDBusMessage)));
+
+    emit finished();
+}
+
+void TrafficReplayer::onMessageReceived(const QDBusMessage &message)
+{
+    if (message.arguments().isEmpty()) {
+        return;
+    }
+
+    const Tp::MessagePartList parts = qdbus_cast<Tp::MessagePartList>(message.arguments().constFirst());
+    if (parts.isEmpty()) {
+        return;
+    }
+
+    const qint64 now = m_timer.nsecsElapsed() / 1000;
+    const Tp::MessagePart &header = parts.constFirst();
+    const auto token = m_pendingTokens.find(header.value(QLatin1String("message-token")).variant().toString());
+    if (token != m_pendingTokens.end()) {
+        const qint64 injectedAt = token.value();
+        m_pendingTokens.erase(token);
+        observe(injectedAt, now);
+        return;
+    }
+
+    const QString sender = header.value(QLatin1String("message-sender-id")).variant().toString();
+    auto it = m_pendingMessages.find(normalizedIdentifier(sender));
+    if (it != m_pendingMessages.end()) {
+        observe(&it.value(), now);
+    }
+}
+
+void TrafficReplayer::onPresencesChanged(const QDBusMessage &message)
+{
+    if (message.arguments().isEmpty()) {
+        return;
+    }
+
+    const qint64 now = m_timer.nsecsElapsed() / 1000;
+    const Tp::SimpleContactPresences presences = qdbus_cast<Tp::SimpleContactPresences>(message.arguments().constFirst());
+    QHash<uint, QString> &identifiers = m_contactIdentifiers[message.path()];
+    Tp::SimpleContactPresences unknownPresences;
+    for (auto presence = presences.constBegin(); presence != presences.constEnd(); ++presence) {
+        const auto identifier = identifiers.constFind(presence.key());
+        if (identifier == identifiers.constEnd()) {
+            unknownPresences.insert(presence.key(), presence.value());
+            continue;
+        }
+        observePresence(identifier.value(), presence.value().status, now);
+    }
+    if (unknownPresences.isEmpty()) {
+        return;
+    }
+
+    // The signal tells only the handles; the handles are never reused, so each one is inspected once
+    QDBusMessage call = QDBusMessage::createMethodCall(message.service(), message.path(),
+                                                      TP_QT_IFACE_CONNECTION, QLatin1String("InspectHandles"));
+    call << static_cast<uint>(Tp::HandleTypeContact) << QVariant::fromValue(Tp::UIntList(unknownPresences.keys()));
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(call), this);
+    const QString path = message.path();
+    connect(watcher, &QDBusPendingCallWatcher::finished,
+            this, [this, path, unknownPresences, now](QDBusPendingCallWatcher *watcher) {
+        watcher->deleteLater();
+        const QDBusPendingReply<QStringList> reply = *watcher;
+        const Tp::UIntList handles = unknownPresences.keys();
+        if (reply.isError() || (reply.value().count() != handles.count())) {
+            return;
+        }
+        QHash<uint, QString> &identifiers = m_contactIdentifiers[path];
+        for (int i = 0; i < handles.count(); ++i) {
+            identifiers.insert(handles.at(i), reply.value().at(i));
+            observePresence(reply.value().at(i), unknownPresences.value(handles.at(i)).status, now);
+        }
+    });
+}
+
+void TrafficReplayer::observePresence(const QString &identifier, const QString &status, qint64 observedAt)
+{
+    auto it = m_pendingPresences.find(qMakePair(normalizedIdentifier(identifier), status));
+    if (it != m_pendingPresences.end()) {
+        observe(&it.value(), observedAt);
+    }
+}
+
+QString TrafficReplayer::normalizedIdentifier(const QString &identifier) const
+{
+    // The connection uses the invalid identifiers as is
+    const QString result = m_service->contactNormalizer()->normalize(identifier);
+    return result.isEmpty() ? identifier : result;
+}
+
+} // SimpleCM
@@ -0,0 +1,100 @@
+#ifndef SIMPLE_TRAFFIC_REPLAYER_HPP
+#define SIMPLE_TRAFFIC_REPLAYER_HPP
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QQueue>
+#include <QVector>
+
+#include "TrafficRecorder.hpp"
+
+QT_FORWARD_DECLARE_CLASS(QDBusMessage)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+namespace SimpleCM {
+
+class Service;
+
+class SIMPLECM_EXPORT TrafficReplayReport
+{
+public:
+    double throughput() const; // Records per second
+    qint64 latencyPercentile(double percentile) const; // Microseconds
+
+    // The nearest-rank percentile of the values (0 for no values)
+    static qint64 percentile(QVector<qint64> values, double percentile);
+
+    int records = 0;
+    int messages = 0;
+    int presences = 0;
+    int contactLists = 0;
+    int jsonMessages = 0;
+    int unobserved = 0; // Records with no D-Bus signal observed before the drain timeout
+    qint64 elapsed = 0; // Microseconds
+    QVector<qint64> latencies; // Microseconds from a host call to the D-Bus signal
+};
+
+class SIMPLECM_EXPORT TrafficReplayer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TrafficReplayer(Service *service, QObject *parent = nullptr);
+
+    // 1.0 replays at the original speed, 2.0 is twice faster, 0 replays as fast as possible
+    double speed() const;
+    void setSpeed(double speed);
+
+    int drainTimeout() const;
+    void setDrainTimeout(int msecs);
+
+    bool isRunning() const;
+    TrafficReplayReport report() const;
+
+public slots:
+    bool start(const QString &fileName);
+
+signals:
+    void finished();
+
+protected slots:
+    void replayNext();
+    void finish();
+
+    void onMessageReceived(const QDBusMessage &message);
+    void onPresencesChanged(const QDBusMessage &message);
+
+protected:
+    void replayRecord(const TrafficRecord &record);
+    void expectMessage(const QString &token, const QString &sender, qint64 injectedAt);
+    void observe(QQueue<qint64> *pending, qint64 observedAt);
+    void observe(qint64 injectedAt, qint64 observedAt);
+    void observePresence(const QString &identifier, const QString &status, qint64 observedAt);
+    QString normalizedIdentifier(const QString &identifier) const;
+    void startDrain();
+
+    Service *m_service = nullptr;
+    TrafficReader m_reader;
+    TrafficRecord m_nextRecord;
+    TrafficReplayReport m_report;
+    QElapsedTimer m_timer;
+    QTimer *m_replayTimer = nullptr;
+    QTimer *m_drainTimer = nullptr;
+    double m_speed = 1.0;
+    int m_drainTimeout = 5000;
+    int m_pendingCount = 0;
+    bool m_running = false;
+    bool m_draining = false;
+
+    // Injection timestamps of the host calls waiting for the D-Bus signal
+    QHash<QString, qint64> m_pendingTokens; // By the message token given in the JSON
+    QHash<QString, QQueue<qint64>> m_pendingMessages; // By the normalized sender identifier
+    QHash<QPair<QString, QString>, QQueue<qint64>> m_pendingPresences; // By the normalized contact identifier and the status
+    // The contact identifiers by the connection object path and the handle
+    QHash<QString, QHash<uint, QString>> m_contactIdentifiers;
+};
+
+} // SimpleCM
+
+#endif // SIMPLE_TRAFFIC_REPLAYER_HPP
@@ -14,15 +14,22 @@
 #include "connection.h"
 
 #include "Chat.hpp"
+#include "ContactNormalizer.hpp"
+#include "ContactsSnapshot.hpp"
+#include "MemoryUsage.hpp"
 #include "Message.hpp"
+#include "Metrics.hpp"
 #include "textchannel.h"
+#include "Trace.hpp"
 
 #include <TelepathyQt/Constants>
 #include <TelepathyQt/BaseChannel>
 
 #include <QDateTime>
+#include <QSet>
+#include <QThread>
+#include <QTimer>
 
-#include <QDebug>
 
 Tp::SimpleStatusSpecMap SimpleConnection::getSimpleStatusSpecMap()
 {
@@ -80,14 +87,28 @@ SimpleConnection::SimpleConnection(const QDBusConnection &dbusConnection, const
     text.fixedProperties[TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType")]  = Tp::HandleTypeContact;
     text.allowedProperties.append(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle"));
     text.allowedProperties.append(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID"));
-    requestsIface->requestableChannelClasses << text;
+    Tp::RequestableChannelClass roomText;
+    roomText.fixedProperties[TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType")] = TP_QT_IFACE_CHANNEL_TYPE_TEXT;
+    roomText.fixedProperties[TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType")]  = Tp::HandleTypeRoom;
+    roomText.allowedProperties.append(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle"));
+    roomText.allowedProperties.append(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID"));
+    requestsIface->requestableChannelClasses << text << roomText;
     plugInterface(Tp::AbstractConnectionInterfacePtr::dynamicCast(requestsIface));
 
     if (parameters.contains(QLatin1String("self_id"))) {
         m_selfId = parameters.value(QLatin1String("self_id")).toString();
     }
 
-    setSelfContact(addContact(m_selfId), m_selfId);
+    m_clock.start();
+    m_sweepTimer = new QTimer(this);
+    connect(m_sweepTimer, &QTimer::timeout, this, &SimpleConnection::sweepHandles);
+    m_evictionTimer = new QTimer(this);
+    m_evictionTimer->setSingleShot(true);
+    connect(m_evictionTimer, &QTimer::timeout, this, &SimpleConnection::evictTextChannels);
+    m_prewarmTimer = new QTimer(this);
+    connect(m_prewarmTimer, &QTimer::timeout, this, &SimpleConnection::prewarmNextTextChannel);
+
+    setSelfContact(ensureContact(m_selfId), m_selfId);
 
     setConnectCallback(Tp::memFun(this, &SimpleConnection::connectCallback));
     setInspectHandlesCallback(Tp::memFun(this, &SimpleConnection::inspectHandles));
@@ -99,6 +120,15 @@ SimpleConnection::SimpleConnection(const QDBusConnection &dbusConnection, const
 
 SimpleConnection::~SimpleConnection()
 {
+    // Save the state of a connection torn down without a disconnect (e.g. on the service stop)
+    if (!m_snapshotFileName.isEmpty() && ((status() == Tp::ConnectionStatusConnected) || m_suspended)) {
+        saveSnapshot(m_snapshotFileName);
+    }
+}
+
+QString SimpleConnection::accountId() const
+{
+    return m_selfId;
 }
 
 void SimpleConnection::connectCallback(Tp::DBusError *error)
@@ -107,6 +137,11 @@ void SimpleConnection::connectCallback(Tp::DBusError *error)
 
     simplePresenceIface->setStatuses(getSimpleStatusSpecMap());
 
+    // Restore only into a fresh connection to keep the known handles stable
+    if (!m_snapshotFileName.isEmpty() && (m_handles.count() <= 1)) {
+        restoreSnapshot(m_snapshotFileName);
+    }
+
     Tp::SimpleContactPresences presences;
     Tp::SimplePresence presence;
     presence.status = QLatin1String("available");
@@ -119,18 +154,65 @@ void SimpleConnection::connectCallback(Tp::DBusError *error)
 
     /* Set ContactList status */
     contactListIface->setContactListState(Tp::ContactListStateSuccess);
+
+    startPrewarming();
 }
 
 void SimpleConnection::onDisconnectRequested()
 {
+    if (!m_snapshotFileName.isEmpty() && ((status() == Tp::ConnectionStatusConnected) || m_suspended)) {
+        saveSnapshot(m_snapshotFileName);
+    }
+    m_suspended = false;
+    m_prewarmQueue.clear();
+    m_prewarmTimer->stop();
+    // BaseConnection closes the announced channels only
+    const QList<Tp::BaseChannelPtr> unannounced = m_unannouncedTextChannels.values();
+    m_unannouncedTextChannels.clear();
+    for (const Tp::BaseChannelPtr &channel : unannounced) {
+        channel->close();
+    }
     setStatus(Tp::ConnectionStatusDisconnected, Tp::ConnectionStatusReasonRequested);
 }
 
+bool SimpleConnection::isSuspended() const
+{
+    return m_suspended;
+}
+
+void SimpleConnection::suspend()
+{
+    if (m_suspended || (status() != Tp::ConnectionStatusConnected)) {
+        return;
+    }
+    m_suspended = true;
+
+    // A Disconnected status is final for the clients, so the connection goes back to Connecting
+    setStatus(Tp::ConnectionStatusConnecting, Tp::ConnectionStatusReasonNetworkError);
+}
+
+void SimpleConnection::resume()
+{
+    if (!m_suspended) {
+        return;
+    }
+    m_suspended = false;
+    setStatus(Tp::ConnectionStatusConnected, Tp::ConnectionStatusReasonNoneSpecified);
+}
+
 QStringList SimpleConnection::inspectHandles(uint handleType, const Tp::UIntList &handles, Tp::DBusError *error)
 {
-    qDebug() << Q_FUNC_INFO;
+    SIMPLECM_TRACE(lcSimpleConnection) << Q_FUNC_INFO;
 
-    if (handleType != Tp::HandleTypeContact) {
+    const QMap<uint, QString> *knownHandles = nullptr;
+    switch (handleType) {
+    case Tp::HandleTypeContact:
+        knownHandles = &m_handles;
+        break;
+    case Tp::HandleTypeRoom:
+        knownHandles = &m_roomHandles;
+        break;
+    default:
         error->set(TP_QT_ERROR_INVALID_ARGUMENT, QLatin1String("Unsupported handle type"));
         return QStringList();
     }
@@ -138,11 +220,14 @@ QStringList SimpleConnection::inspectHandles(uint handleType, const Tp::UIntList
     QStringList result;
 
     foreach (uint handle, handles) {
-        if (!m_handles.contains(handle)) {
+        if (!knownHandles->contains(handle)) {
             return QStringList();
         }
 
-        result.append(m_handles.value(handle));
+        result.append(knownHandles->value(handle));
+    }
+    if (handleType == Tp::HandleTypeContact) {
+        touchHandles(handles);
     }
 
     return result;
@@ -150,6 +235,7 @@ QStringList SimpleConnection::inspectHandles(uint handleType, const Tp::UIntList
 
 Tp::BaseChannelPtr SimpleConnection::createChannel(const QVariantMap &request, Tp::DBusError *error)
 {
+    SIMPLECM_TRACE_SCOPE("SimpleConnection::createChannel");
     const QString channelType = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType")).toString();
 
     uint targetHandleType = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType")).toUInt();
@@ -166,6 +252,15 @@ Tp::BaseChannelPtr SimpleConnection::createChannel(const QVariantMap &request, T
             targetHandle = ensureContact(targetID);
         }
         break;
+    case Tp::HandleTypeRoom:
+        if (request.contains(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle"))) {
+            targetHandle = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle")).toUInt();
+            targetID = m_roomHandles.value(targetHandle);
+        } else if (request.contains(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID"))) {
+            targetID = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".TargetID")).toString();
+            targetHandle = ensureRoom(targetID);
+        }
+        break;
     default:
         break;
     }
@@ -173,17 +268,18 @@ Tp::BaseChannelPtr SimpleConnection::createChannel(const QVariantMap &request, T
     // Looks like there is no any case for InitiatorID other than selfID
     uint initiatorHandle = 0;
 
-    if (targetHandleType == Tp::HandleTypeContact) {
+    if ((targetHandleType == Tp::HandleTypeContact) || (targetHandleType == Tp::HandleTypeRoom)) {
         initiatorHandle = request.value(TP_QT_IFACE_CHANNEL + QLatin1String(".InitiatorHandle"), selfHandle()).toUInt();
     }
 
-    qDebug() << "SimpleConnection::createChannel " << channelType
+    SIMPLECM_TRACE(lcSimpleConnection) << "SimpleConnection::createChannel " << channelType
              << " " << targetHandleType
              << " " << targetHandle
              << " " << request;
 
     switch (targetHandleType) {
     case Tp::HandleTypeContact:
+    case Tp::HandleTypeRoom:
         break;
     default:
         if (error) {
@@ -200,6 +296,15 @@ Tp::BaseChannelPtr SimpleConnection::createChannel(const QVariantMap &request, T
         return Tp::BaseChannelPtr();
     }
 
+    // A pre-created channel is announced by the caller (BaseConnection) like a new one
+    if ((channelType == TP_QT_IFACE_CHANNEL_TYPE_TEXT) && (targetHandleType == Tp::HandleTypeContact)) {
+        const Tp::BaseChannelPtr unannounced = m_unannouncedTextChannels.take(targetHandle);
+        if (unannounced) {
+            unannounced->setInitiatorHandle(initiatorHandle);
+            return unannounced;
+        }
+    }
+
     Tp::BaseChannelPtr baseChannel = Tp::BaseChannel::create(this, channelType, Tp::HandleType(targetHandleType), targetHandle);
     baseChannel->setTargetID(targetID);
     baseChannel->setInitiatorHandle(initiatorHandle);
@@ -207,10 +312,58 @@ Tp::BaseChannelPtr SimpleConnection::createChannel(const QVariantMap &request, T
     if (channelType == TP_QT_IFACE_CHANNEL_TYPE_TEXT) {
         SimpleTextChannelPtr textChannel = SimpleTextChannel::create(baseChannel.data());
         baseChannel->plugInterface(Tp::AbstractChannelInterfacePtr::dynamicCast(textChannel));
+        m_textChannels.insert(baseChannel.data(), textChannel);
+        Tp::BaseChannel *channelObject = baseChannel.data();
+        const bool isRoom = (targetHandleType == Tp::HandleTypeRoom);
+        if (!isRoom) {
+            ++m_evictableTextChannels;
+        }
+        connect(channelObject, &Tp::BaseChannel::closed, this, [this, channelObject, isRoom, targetHandle]() {
+            if (isEvictable(channelObject)) {
+                --m_evictableTextChannels;
+            }
+            if (!isRoom && (m_unannouncedTextChannels.value(targetHandle).data() == channelObject)) {
+                m_unannouncedTextChannels.remove(targetHandle);
+            }
+            m_textChannels.remove(channelObject);
+            const auto activity = m_textChannelActivity.find(channelObject);
+            if (activity != m_textChannelActivity.end()) {
+                m_textChannelsByActivity.remove(activity->sequence);
+                m_textChannelActivity.erase(activity);
+            }
+        });
+        const SimpleCM::Chat::Type chatType = (targetHandleType == Tp::HandleTypeRoom) ? SimpleCM::Chat::Room : SimpleCM::Chat::Contact;
         connect(textChannel.data(), &SimpleTextChannel::sendMessage,
-                this, &SimpleConnection::onChannelSendMessageRequested);
+                this, [this, chatType, channelObject](const QString &target, const QString &content) {
+            touchTextChannel(channelObject);
+            onChannelSendMessageRequested(SimpleCM::Chat(target, chatType), content);
+        });
+        SimpleTextChannel *textChannelObject = textChannel.data();
+        connect(textChannelObject, &SimpleTextChannel::messagesPending, this, [this, isRoom]() {
+            if (!isRoom) {
+                --m_evictableTextChannels;
+            }
+        });
+        connect(textChannelObject, &SimpleTextChannel::messagesAcknowledged, this, [this, channelObject, textChannelObject, isRoom]() {
+            touchTextChannel(channelObject);
+            if (isRoom || textChannelObject->pendingMessageCount()) {
+                return;
+            }
+            ++m_evictableTextChannels;
+            // The channel can be evicted again once it is idle
+            if (m_textChannelLimit && (m_evictableTextChannels > m_textChannelLimit)) {
+                scheduleEviction(qMax(1000, m_textChannelIdleTimeout / 2));
+            }
+        });
+        touchTextChannel(channelObject);
+        if (m_textChannelLimit && (m_evictableTextChannels > m_textChannelLimit)) {
+            // Not from here: the new channel is yet to be returned and to get its first message
+            scheduleEviction(0);
+        }
     }
 
+    SimpleCM::Metrics::increment(SimpleCM::Metrics::ChannelsCreated);
+
     return baseChannel;
 }
 
@@ -224,6 +377,10 @@ SimpleTextChannelPtr SimpleConnection::ensureTextChannel(const SimpleCM::Chat &c
         targetHandleType = Tp::HandleTypeContact;
         targetHandle = ensureContact(chat.identifier);
         initiatorHandle = targetHandle;
+    } else if (chat.type == SimpleCM::Chat::Room) {
+        targetHandleType = Tp::HandleTypeRoom;
+        targetHandle = ensureRoom(chat.identifier);
+        initiatorHandle = selfHandle();
     } else {
         return SimpleTextChannelPtr();
     }
@@ -243,30 +400,45 @@ SimpleTextChannelPtr SimpleConnection::ensureTextChannel(const SimpleCM::Chat &c
         return SimpleTextChannelPtr();
     }
 
+    touchTextChannel(channel.data());
     return SimpleTextChannelPtr::dynamicCast(channel->interface(TP_QT_IFACE_CHANNEL_TYPE_TEXT));
 }
 
 Tp::UIntList SimpleConnection::requestHandles(uint handleType, const QStringList &identifiers, Tp::DBusError *error)
 {
-    qDebug() << Q_FUNC_INFO << identifiers;
+    SIMPLECM_TRACE_SCOPE("SimpleConnection::requestHandles");
+    SIMPLECM_TRACE(lcSimpleConnection) << Q_FUNC_INFO << identifiers;
 
     Tp::UIntList result;
 
+    if (handleType == Tp::HandleTypeRoom) {
+        foreach(const QString &identify, identifiers) {
+            result.append(ensureRoom(identify));
+        }
+        return result;
+    }
+
     if (handleType != Tp::HandleTypeContact) {
         error->set(TP_QT_ERROR_INVALID_ARGUMENT, QLatin1String("SimpleConnection::requestHandles - Handle Type unknown"));
         return result;
     }
 
     foreach(const QString &identify, identifiers) {
+        if (m_normalizer && m_normalizer->normalize(identify).isEmpty()) {
+            error->set(TP_QT_ERROR_INVALID_HANDLE, QLatin1String("Invalid contact identifier: ") + identify);
+            return Tp::UIntList();
+        }
         result.append(ensureContact(identify));
     }
+    touchHandles(result);
 
     return result;
 }
 
 Tp::ContactAttributesMap SimpleConnection::getContactListAttributes(const QStringList &interfaces, bool hold, Tp::DBusError *error)
 {
-    qDebug() << Q_FUNC_INFO;
+    SIMPLECM_TRACE_SCOPE("SimpleConnection::getContactListAttributes");
+    SIMPLECM_TRACE(lcSimpleConnection) << Q_FUNC_INFO;
 
     Tp::ContactAttributesMap contactAttributes;
 
@@ -286,9 +458,10 @@ Tp::ContactAttributesMap SimpleConnection::getContactListAttributes(const QStrin
 
 Tp::ContactAttributesMap SimpleConnection::getContactAttributes(const Tp::UIntList &handles, const QStringList &interfaces, Tp::DBusError *error)
 {
+    SIMPLECM_TRACE_SCOPE("SimpleConnection::getContactAttributes");
 //    Connection.Interface.Contacts
 //    http://telepathy.freedesktop.org/spec/Connection_Interface_Contacts.html#Method:GetContactAttributes
-    qDebug() << Q_FUNC_INFO << handles;
+    SIMPLECM_TRACE(lcSimpleConnection) << Q_FUNC_INFO << handles;
 
     Tp::ContactAttributesMap contactAttributes;
 
@@ -322,34 +495,216 @@ Tp::SimplePresence SimpleConnection::getPresence(uint handle)
 
 uint SimpleConnection::setPresence(const QString &status, const QString &message, Tp::DBusError *error)
 {
-    qDebug() << Q_FUNC_INFO << "not implemented";
+    SIMPLECM_TRACE(lcSimpleConnection) << Q_FUNC_INFO << "not implemented";
     return selfHandle();
 }
 
 uint SimpleConnection::ensureContact(const QString &identifier)
 {
-    uint handle = getHandle(identifier);
+    const QString normalizedIdentifier = normalizeIdentifier(identifier);
+    uint handle = getHandle(normalizedIdentifier);
     if (!handle) {
-        handle = addContact(identifier);
+        handle = addContact(normalizedIdentifier);
+    } else if (m_handleGracePeriod) {
+        m_handleLastUsed.insert(handle, m_clock.elapsed());
     }
     return handle;
 }
 
+Tp::UIntList SimpleConnection::ensureContacts(const QStringList &rawIdentifiers)
+{
+    QStringList identifiers;
+    identifiers.reserve(rawIdentifiers.count());
+    for (const QString &identifier : rawIdentifiers) {
+        identifiers << normalizeIdentifier(identifier);
+    }
+
+    QStringList newIdentifiers;
+    QSet<QString> seenIdentifiers;
+    for (const QString &identifier : identifiers) {
+        if (getHandle(identifier) || seenIdentifiers.contains(identifier)) {
+            continue;
+        }
+        seenIdentifiers.insert(identifier);
+        newIdentifiers << identifier;
+    }
+    // Add all unknown contacts at once to get a single change notification
+    if (!newIdentifiers.isEmpty()) {
+        addContacts(newIdentifiers);
+    }
+
+    Tp::UIntList handles;
+    handles.reserve(identifiers.count());
+    for (const QString &identifier : identifiers) {
+        handles.append(getHandle(identifier));
+    }
+    touchHandles(handles);
+    return handles;
+}
+
+uint SimpleConnection::ensureRoom(const QString &identifier)
+{
+    uint handle = m_roomIdentifiers.value(identifier, 0);
+    if (handle) {
+        return handle;
+    }
+
+    handle = m_roomHandles.isEmpty() ? 1 : m_roomHandles.lastKey() + 1;
+    m_roomHandles.insert(m_roomHandles.constEnd(), handle, identifier);
+    m_roomIdentifiers.insert(identifier, handle);
+    m_identifierBytes += SimpleCM::MemoryUsage::stringBytes(identifier);
+    return handle;
+}
+
+QSharedPointer<SimpleCM::ContactNormalizer> SimpleConnection::contactNormalizer() const
+{
+    return m_normalizer;
+}
+
+void SimpleConnection::setContactNormalizer(const QSharedPointer<SimpleCM::ContactNormalizer> &normalizer)
+{
+    m_normalizer = normalizer;
+
+    // The self contact is added before the normalizer is known
+    const uint handle = selfHandle();
+    const QString identifier = normalizeIdentifier(m_selfId);
+    const QString oldIdentifier = m_handles.value(handle);
+    if (identifier != oldIdentifier) {
+        m_identifiers.remove(oldIdentifier);
+        m_identifiers.insert(identifier, handle);
+        m_handles.insert(handle, identifier);
+        m_identifierBytes += SimpleCM::MemoryUsage::stringBytes(identifier) - SimpleCM::MemoryUsage::stringBytes(oldIdentifier);
+        setSelfContact(handle, identifier);
+    }
+}
+
+QString SimpleConnection::normalizeIdentifier(const QString &identifier) const
+{
+    if (!m_normalizer) {
+        return identifier;
+    }
+    const QString result = m_normalizer->normalize(identifier);
+    return result.isEmpty() ? identifier : result;
+}
+
+QString SimpleConnection::snapshotFileName() const
+{
+    return m_snapshotFileName;
+}
+
+void SimpleConnection::setSnapshotFileName(const QString &fileName)
+{
+    m_snapshotFileName = fileName;
+}
+
+bool SimpleConnection::saveSnapshot(const QString &fileName) const
+{
+    SimpleCM::ContactsSnapshot snapshot;
+    snapshot.selfHandle = selfHandle();
+    snapshot.handles = m_handles;
+    snapshot.presences = m_presences;
+    snapshot.subscriptions = m_contactsSubscription;
+    return snapshot.save(fileName);
+}
+
+bool SimpleConnection::restoreSnapshot(const QString &fileName)
+{
+    SimpleCM::ContactsSnapshot snapshot;
+    if (!snapshot.load(fileName)) {
+        return false;
+    }
+    const QString selfIdentifier = normalizeIdentifier(m_selfId);
+    if (snapshot.handles.value(snapshot.selfHandle) != selfIdentifier) {
+        qWarning() << Q_FUNC_INFO << "The snapshot belongs to another account";
+        return false;
+    }
+
+    m_handles = snapshot.handles;
+    m_lastHandle = m_handles.isEmpty() ? 0 : m_handles.lastKey();
+    m_presences = snapshot.presences;
+    m_contactsSubscription = snapshot.subscriptions;
+
+    m_identifiers.clear();
+    m_identifiers.reserve(m_handles.count());
+    m_identifierBytes = 0;
+    for (auto it = m_roomHandles.constBegin(); it != m_roomHandles.constEnd(); ++it) {
+        m_identifierBytes += SimpleCM::MemoryUsage::stringBytes(it.value());
+    }
+    for (auto it = m_handles.constBegin(); it != m_handles.constEnd(); ++it) {
+        m_identifiers.insert(it.value(), it.key());
+        m_identifierBytes += SimpleCM::MemoryUsage::stringBytes(it.value());
+    }
+
+    m_handleLastUsed.clear();
+    touchHandles(m_handles.keys());
+
+    setSelfContact(snapshot.selfHandle, selfIdentifier);
+
+    // The clients learn the restored roster the same way as the one set by the host
+    simplePresenceIface->setPresences(m_presences);
+
+    Tp::ContactSubscriptionMap changes;
+    Tp::HandleIdentifierMap identifiersMap;
+    for (auto it = m_contactsSubscription.constBegin(); it != m_contactsSubscription.constEnd(); ++it) {
+        if (it.value() == Tp::SubscriptionStateUnknown) {
+            continue;
+        }
+        Tp::ContactSubscriptions change;
+        change.publish = Tp::SubscriptionStateYes;
+        change.publishRequest = QString();
+        change.subscribe = it.value();
+        changes[it.key()] = change;
+        identifiersMap[it.key()] = m_handles.value(it.key());
+    }
+    if (!changes.isEmpty()) {
+        contactListIface->contactsChangedWithID(changes, identifiersMap, Tp::HandleIdentifierMap());
+    }
+    return true;
+}
+
+void SimpleConnection::moveToWorkerThread(QThread *thread)
+{
+    moveToThread(thread);
+
+    // The interfaces are not children of the connection
+    contactsIface->moveToThread(thread);
+    simplePresenceIface->moveToThread(thread);
+    contactListIface->moveToThread(thread);
+    requestsIface->moveToThread(thread);
+}
+
+void SimpleConnection::invoke(const std::function<void()> &function, bool blocking)
+{
+    if (thread() == QThread::currentThread()) {
+        function();
+        return;
+    }
+
+    QMetaObject::invokeMethod(this, function, blocking ? Qt::BlockingQueuedConnection : Qt::QueuedConnection);
+}
+
 uint SimpleConnection::addContacts(const QStringList &identifiers)
 {
-    qDebug() << Q_FUNC_INFO;
-    uint handle = 0;
+    SIMPLECM_TRACE_SCOPE("SimpleConnection::addContacts");
+    SIMPLECM_TRACE(lcSimpleConnection) << Q_FUNC_INFO;
+    // Released handles are never reused
+    uint handle = m_lastHandle;
 
     if (!m_handles.isEmpty()) {
-        handle = m_handles.keys().last();
+        handle = qMax(handle, m_handles.lastKey());
     }
 
     QList<uint> newHandles;
     foreach(const QString &identifier, identifiers) {
         ++handle;
-        m_handles.insert(handle, identifier);
+        m_handles.insert(m_handles.constEnd(), handle, identifier);
+        m_identifiers.insert(identifier, handle);
+        m_identifierBytes += SimpleCM::MemoryUsage::stringBytes(identifier);
         newHandles << handle;
     }
+    m_lastHandle = handle;
+    touchHandles(newHandles);
+    SimpleCM::Metrics::increment(SimpleCM::Metrics::ContactsAdded, static_cast<quint64>(newHandles.count()));
 
     setPresenceState(newHandles, QLatin1String("unknown"));
     setSubscriptionState(identifiers, newHandles, Tp::SubscriptionStateUnknown);
@@ -359,14 +714,17 @@ uint SimpleConnection::addContacts(const QStringList &identifiers)
 
 uint SimpleConnection::addContact(const QString &identifier)
 {
-    qDebug() << Q_FUNC_INFO;
+    SIMPLECM_TRACE(lcSimpleConnection) << Q_FUNC_INFO;
     return addContacts(QStringList() << identifier);
 }
 
 void SimpleConnection::setPresenceState(const QList<uint> &handles, const QString &status)
 {
-    qDebug() << Q_FUNC_INFO;
+    SIMPLECM_TRACE_SCOPE("SimpleConnection::setPresenceState");
+    SIMPLECM_TRACE(lcSimpleConnection) << Q_FUNC_INFO;
     Tp::SimpleContactPresences newPresences;
+    QStringList identifiers;
+    identifiers.reserve(handles.count());
     const static Tp::SimpleStatusSpecMap statusSpecMap = getSimpleStatusSpecMap();
     foreach (uint handle, handles) {
         uint type = 0;
@@ -380,13 +738,18 @@ void SimpleConnection::setPresenceState(const QList<uint> &handles, const QStrin
         presence.type = type;
         m_presences[handle] = presence;
         newPresences[handle] = presence;
+        identifiers.append(m_handles.value(handle));
     }
     simplePresenceIface->setPresences(newPresences);
+    SimpleCM::Metrics::increment(SimpleCM::Metrics::PresenceUpdates);
+
+    emit contactPresencesChanged(m_selfId, identifiers, status);
 }
 
 void SimpleConnection::setSubscriptionState(const QStringList &identifiers, const QList<uint> &handles, uint state)
 {
-    qDebug() << Q_FUNC_INFO;
+    SIMPLECM_TRACE_SCOPE("SimpleConnection::setSubscriptionState");
+    SIMPLECM_TRACE(lcSimpleConnection) << Q_FUNC_INFO;
     Tp::ContactSubscriptionMap changes;
     Tp::HandleIdentifierMap identifiersMap;
 
@@ -406,38 +769,95 @@ void SimpleConnection::setSubscriptionState(const QStringList &identifiers, cons
 /* Receive message from someone to ourself */
 void SimpleConnection::receiveMessage(const QString &identifier, const QString &message)
 {
+    SIMPLECM_TRACE_SCOPE("SimpleConnection::receiveMessage");
     SimpleTextChannelPtr textChannel = ensureTextChannel(SimpleCM::Chat::fromContactId(identifier));
 
     if (!textChannel) {
-        qDebug() << Q_FUNC_INFO << "Error: channel is not a SimpleTextChannel?";
+        qCWarning(lcSimpleConnection) << Q_FUNC_INFO << "Error: channel is not a SimpleTextChannel?";
         return;
     }
 
     textChannel->addIncomingMessage(message);
+    SimpleCM::Metrics::increment(SimpleCM::Metrics::MessagesIn);
 
     SimpleCM::Message apiMessage;
+    apiMessage.account = m_selfId;
     apiMessage.chat = SimpleCM::Chat::fromContactId(identifier);
     apiMessage.from = identifier;
     apiMessage.text = message;
     emit newMessage(apiMessage);
 }
 
+void SimpleConnection::receiveRoomMessage(const QString &room, const QString &sender, const QString &message)
+{
+    SIMPLECM_TRACE_SCOPE("SimpleConnection::receiveRoomMessage");
+    SimpleTextChannelPtr textChannel = ensureTextChannel(SimpleCM::Chat::fromRoomId(room));
+    if (!textChannel) {
+        qCWarning(lcSimpleConnection) << Q_FUNC_INFO << "Error: channel is not a SimpleTextChannel?";
+        return;
+    }
+
+    const uint senderHandle = ensureContact(sender);
+    textChannel->addIncomingMessage(message, senderHandle, m_handles.value(senderHandle));
+    SimpleCM::Metrics::increment(SimpleCM::Metrics::MessagesIn);
+
+    SimpleCM::Message apiMessage;
+    apiMessage.account = m_selfId;
+    apiMessage.chat = SimpleCM::Chat::fromRoomId(room);
+    apiMessage.from = sender;
+    apiMessage.text = message;
+    emit newMessage(apiMessage);
+}
+
+void SimpleConnection::addRoomMembers(const QString &room, const QStringList &identifiers)
+{
+    SimpleTextChannelPtr textChannel = ensureTextChannel(SimpleCM::Chat::fromRoomId(room));
+    if (!textChannel) {
+        return;
+    }
+
+    Tp::HandleIdentifierMap members;
+    for (uint handle : ensureContacts(identifiers)) {
+        members.insert(handle, m_handles.value(handle));
+    }
+    textChannel->addMembers(members);
+}
+
+void SimpleConnection::removeRoomMembers(const QString &room, const QStringList &identifiers)
+{
+    SimpleTextChannelPtr textChannel = ensureTextChannel(SimpleCM::Chat::fromRoomId(room));
+    if (!textChannel) {
+        return;
+    }
+
+    Tp::UIntList handles;
+    handles.reserve(identifiers.count());
+    for (const QString &identifier : identifiers) {
+        const uint handle = getHandle(normalizeIdentifier(identifier));
+        if (handle) {
+            handles.append(handle);
+        }
+    }
+    textChannel->removeMembers(handles);
+}
+
 void SimpleConnection::setContactList(const QStringList &identifiers)
 {
     // Actually it don't clear previous list (not implemented yet)
-    addContacts(identifiers);
 
 //    Tp::ContactSubscriptionMap changes;
 //    Tp::HandleIdentifierMap identifiers;
 //    Tp::HandleIdentifierMap removals;
 
-    QList<uint> handles;
+    // Known contacts keep their handles, so a restored roster only needs the delta
+    const Tp::UIntList handles = ensureContacts(identifiers);
 
-    for (int i = 0; i < identifiers.count(); ++i) {
-        handles.append(ensureContact(identifiers.at(i)));
+    QStringList normalizedIdentifiers;
+    normalizedIdentifiers.reserve(handles.count());
+    for (uint handle : handles) {
+        normalizedIdentifiers << m_handles.value(handle);
     }
-
-    setSubscriptionState(identifiers, handles, Tp::SubscriptionStateYes);
+    setSubscriptionState(normalizedIdentifiers, handles, Tp::SubscriptionStateYes);
 }
 
 void SimpleConnection::setContactPresence(const QString &identifier, const QString &presence)
@@ -447,19 +867,345 @@ void SimpleConnection::setContactPresence(const QString &identifier, const QStri
 
     // Let it be here until proper subscription implementation
     if (handle != selfHandle()) {
-        setSubscriptionState(QStringList() << identifier, QList<uint>() << handle, Tp::SubscriptionStateYes);
+        setSubscriptionState(QStringList() << m_handles.value(handle), QList<uint>() << handle, Tp::SubscriptionStateYes);
     }
 }
 
 uint SimpleConnection::getHandle(const QString &identifier) const
 {
-    return m_handles.key(identifier, 0);
+    return m_identifiers.value(identifier, 0);
+}
+
+void SimpleConnection::touchHandles(const Tp::UIntList &handles)
+{
+    if (!m_handleGracePeriod) {
+        return;
+    }
+    const qint64 now = m_clock.elapsed();
+    for (uint handle : handles) {
+        m_handleLastUsed.insert(handle, now);
+    }
+}
+
+void SimpleConnection::touchTextChannel(Tp::BaseChannel *channel)
+{
+    if (!m_textChannelLimit) {
+        return;
+    }
+    auto it = m_textChannelActivity.find(channel);
+    if (it == m_textChannelActivity.end()) {
+        it = m_textChannelActivity.insert(channel, TextChannelActivity());
+    } else {
+        m_textChannelsByActivity.remove(it->sequence);
+    }
+    it->sequence = ++m_activitySequence;
+    it->lastActive = m_clock.elapsed();
+    m_textChannelsByActivity.insert(it->sequence, channel);
+}
+
+bool SimpleConnection::isEvictable(Tp::BaseChannel *channel) const
+{
+    // The room channels keep the member lists
+    if (channel->targetHandleType() == Tp::HandleTypeRoom) {
+        return false;
+    }
+    const SimpleTextChannelPtr textChannel = m_textChannels.value(channel);
+    return !textChannel || !textChannel->pendingMessageCount();
+}
+
+void SimpleConnection::scheduleEviction(int msecs)
+{
+    if (!m_evictionTimer->isActive() || (m_evictionTimer->remainingTime() > msecs)) {
+        m_evictionTimer->start(msecs);
+    }
+}
+
+int SimpleConnection::handleGracePeriod() const
+{
+    return m_handleGracePeriod;
+}
+
+void SimpleConnection::setHandleGracePeriod(int msecs)
+{
+    m_handleGracePeriod = qMax(0, msecs);
+    if (!m_handleGracePeriod) {
+        m_sweepTimer->stop();
+        m_handleLastUsed.clear();
+        return;
+    }
+
+    // The handles known so far start their grace period now
+    const qint64 now = m_clock.elapsed();
+    for (auto it = m_handles.constBegin(); it != m_handles.constEnd(); ++it) {
+        if (!m_handleLastUsed.contains(it.key())) {
+            m_handleLastUsed.insert(it.key(), now);
+        }
+    }
+    m_sweepTimer->start(qMax(1000, m_handleGracePeriod / 2));
+}
+
+int SimpleConnection::sweepHandles()
+{
+    if (!m_handleGracePeriod) {
+        return 0;
+    }
+
+    QSet<uint> referenced;
+    referenced.insert(selfHandle());
+    for (const SimpleTextChannelPtr &channel : m_textChannels) {
+        for (uint handle : channel->referencedHandles()) {
+            referenced.insert(handle);
+        }
+    }
+
+    const qint64 expiry = m_clock.elapsed() - m_handleGracePeriod;
+    Tp::HandleIdentifierMap removals;
+    for (auto it = m_handleLastUsed.begin(); it != m_handleLastUsed.end(); ) {
+        const uint handle = it.key();
+        const bool onRoster = m_contactsSubscription.value(handle, Tp::SubscriptionStateUnknown) != Tp::SubscriptionStateUnknown;
+        if ((it.value() > expiry) || onRoster || referenced.contains(handle)) {
+            ++it;
+            continue;
+        }
+
+        const QString identifier = m_handles.take(handle);
+        m_identifiers.remove(identifier);
+        m_identifierBytes -= SimpleCM::MemoryUsage::stringBytes(identifier);
+        m_presences.remove(handle);
+        m_contactsSubscription.remove(handle);
+        removals.insert(handle, identifier);
+        it = m_handleLastUsed.erase(it);
+    }
+
+    if (removals.isEmpty()) {
+        return 0;
+    }
+    m_releasedHandles += removals.count();
+    SimpleCM::Metrics::increment(SimpleCM::Metrics::ContactsRemoved, static_cast<quint64>(removals.count()));
+
+    // The released contacts were announced with an unknown subscription
+    contactListIface->contactsChangedWithID(Tp::ContactSubscriptionMap(), Tp::HandleIdentifierMap(), removals);
+
+    SIMPLECM_TRACE(lcSimpleConnection) << Q_FUNC_INFO << "Released" << removals.count() << "handles, kept" << m_handles.count();
+    return removals.count();
+}
+
+int SimpleConnection::textChannelLimit() const
+{
+    return m_textChannelLimit;
+}
+
+void SimpleConnection::setTextChannelLimit(int limit)
+{
+    m_textChannelLimit = qMax(0, limit);
+    if (!m_textChannelLimit) {
+        m_evictionTimer->stop();
+        m_textChannelsByActivity.clear();
+        m_textChannelActivity.clear();
+        return;
+    }
+
+    // The channels opened so far become active now
+    for (auto it = m_textChannels.constBegin(); it != m_textChannels.constEnd(); ++it) {
+        if (!m_textChannelActivity.contains(it.key())) {
+            touchTextChannel(it.key());
+        }
+    }
+    if (m_evictableTextChannels > m_textChannelLimit) {
+        scheduleEviction(0);
+    }
+}
+
+int SimpleConnection::textChannelIdleTimeout() const
+{
+    return m_textChannelIdleTimeout;
+}
+
+void SimpleConnection::setTextChannelIdleTimeout(int msecs)
+{
+    m_textChannelIdleTimeout = qMax(0, msecs);
+    if (m_textChannelLimit && (m_evictableTextChannels > m_textChannelLimit)) {
+        scheduleEviction(0);
+    }
+}
+
+int SimpleConnection::evictTextChannels()
+{
+    if (!m_textChannelLimit) {
+        return 0;
+    }
+    const int excess = m_evictableTextChannels - m_textChannelLimit;
+    if (excess <= 0) {
+        return 0;
+    }
+
+    const qint64 idleSince = m_clock.elapsed() - m_textChannelIdleTimeout;
+    // Closing a channel updates the activity map, so the channels are collected first
+    QList<Tp::BaseChannel *> evicted;
+    for (auto it = m_textChannelsByActivity.constBegin(); it != m_textChannelsByActivity.constEnd(); ++it) {
+        if (evicted.count() == excess) {
+            break;
+        }
+        Tp::BaseChannel *channel = it.value();
+        if (m_textChannelActivity.value(channel).lastActive > idleSince) {
+            // The rest of the channels were active even more recently
+            break;
+        }
+        if (isEvictable(channel)) {
+            evicted.append(channel);
+        }
+    }
+
+    for (Tp::BaseChannel *channel : evicted) {
+        channel->close();
+    }
+    if (!evicted.isEmpty()) {
+        m_evictedTextChannels += evicted.count();
+        SimpleCM::Metrics::increment(SimpleCM::Metrics::ChannelsEvicted, static_cast<quint64>(evicted.count()));
+        SIMPLECM_TRACE(lcSimpleConnection) << Q_FUNC_INFO << "Closed" << evicted.count() << "text channels, kept" << m_textChannels.count();
+    }
+
+    // Retry for the channels that are not idle long enough yet
+    if (m_evictableTextChannels > m_textChannelLimit) {
+        scheduleEviction(qMax(1000, m_textChannelIdleTimeout / 2));
+    }
+    return evicted.count();
+}
+
+QStringList SimpleConnection::hotContacts() const
+{
+    return m_hotContacts;
+}
+
+void SimpleConnection::setHotContacts(const QStringList &identifiers)
+{
+    m_hotContacts = identifiers;
+    if (status() == Tp::ConnectionStatusConnected) {
+        startPrewarming();
+    }
+}
+
+void SimpleConnection::startPrewarming()
+{
+    m_prewarmQueue = m_hotContacts;
+    if (m_prewarmQueue.isEmpty()) {
+        m_prewarmTimer->stop();
+        return;
+    }
+    // A zero interval timer fires once the pending events are processed
+    m_prewarmTimer->start(0);
+}
+
+void SimpleConnection::prewarmNextTextChannel()
+{
+    // The channels above the limit would be evicted right away
+    const bool atLimit = m_textChannelLimit && (m_evictableTextChannels >= m_textChannelLimit);
+    if (m_prewarmQueue.isEmpty() || atLimit || (status() != Tp::ConnectionStatusConnected)) {
+        m_prewarmQueue.clear();
+        m_prewarmTimer->stop();
+        return;
+    }
+
+    SIMPLECM_TRACE_SCOPE("SimpleConnection::prewarmNextTextChannel");
+    const uint targetHandle = ensureContact(m_prewarmQueue.takeFirst());
+    if (!targetHandle || m_unannouncedTextChannels.contains(targetHandle)) {
+        return;
+    }
+    for (Tp::BaseChannel *channel : m_textChannels.keys()) {
+        if ((channel->targetHandleType() == Tp::HandleTypeContact) && (channel->targetHandle() == targetHandle)) {
+            return;
+        }
+    }
+
+    QVariantMap request;
+    request[TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType")] = TP_QT_IFACE_CHANNEL_TYPE_TEXT;
+    request[TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandle")] = targetHandle;
+    request[TP_QT_IFACE_CHANNEL + QLatin1String(".TargetHandleType")] = Tp::HandleTypeContact;
+    request[TP_QT_IFACE_CHANNEL + QLatin1String(".InitiatorHandle")] = targetHandle;
+
+    // The channel is built and registered on the bus but not announced: nobody has written yet.
+    // createChannel() hands it over once the first message (or a client request) ensures it.
+    Tp::DBusError error;
+    const Tp::BaseChannelPtr channel = createChannel(request, &error);
+    if (!error.isValid()) {
+        channel->registerObject(&error);
+    }
+    if (error.isValid()) {
+        qCWarning(lcSimpleConnection) << Q_FUNC_INFO << "Unable to pre-create the channel:" << error.name() << error.message();
+        if (channel) {
+            channel->close();
+        }
+        return;
+    }
+    m_unannouncedTextChannels.insert(targetHandle, channel);
+    ++m_prewarmedTextChannels;
+}
+
+QVariantMap SimpleConnection::handleStatistics() const
+{
+    int rosterHandles = 0;
+    for (uint state : m_contactsSubscription) {
+        if (state != Tp::SubscriptionStateUnknown) {
+            ++rosterHandles;
+        }
+    }
+    int pendingMessages = 0;
+    for (const SimpleTextChannelPtr &channel : m_textChannels) {
+        pendingMessages += channel->pendingMessageCount();
+    }
+
+    QVariantMap result;
+    result[QLatin1String("handles")] = m_handles.count();
+    result[QLatin1String("roster-handles")] = rosterHandles;
+    result[QLatin1String("room-handles")] = m_roomHandles.count();
+    result[QLatin1String("presences")] = m_presences.count();
+    result[QLatin1String("subscriptions")] = m_contactsSubscription.count();
+    result[QLatin1String("text-channels")] = m_textChannels.count();
+    result[QLatin1String("pending-messages")] = pendingMessages;
+    result[QLatin1String("released-handles")] = m_releasedHandles;
+    result[QLatin1String("evicted-text-channels")] = m_evictedTextChannels;
+    result[QLatin1String("prewarmed-text-channels")] = m_prewarmedTextChannels;
+    return result;
+}
+
+QVariantMap SimpleConnection::memoryUsage() const
+{
+    using namespace SimpleCM::MemoryUsage;
+
+    // The identifier strings are shared by the maps of both directions
+    const qint64 handles = (m_handles.count() + m_roomHandles.count())
+            * (mapEntryBytes<uint, QString>() + hashEntryBytes<QString, uint>())
+            + m_handleLastUsed.count() * hashEntryBytes<uint, qint64>()
+            + m_identifierBytes;
+    // The status strings are shared by the contacts updated in one call
+    const qint64 presences = m_presences.count() * mapEntryBytes<uint, Tp::SimplePresence>();
+    const qint64 subscriptions = m_contactsSubscription.count() * hashEntryBytes<uint, uint>();
+
+    qint64 channels = 0;
+    qint64 pendingMessages = 0;
+    for (const SimpleTextChannelPtr &channel : m_textChannels) {
+        channels += hashEntryBytes<Tp::BaseChannel *, SimpleTextChannelPtr>() + channel->channelBytes();
+        pendingMessages += channel->pendingMessageBytes();
+    }
+    channels += m_textChannelActivity.count()
+            * (hashEntryBytes<Tp::BaseChannel *, TextChannelActivity>() + mapEntryBytes<quint64, Tp::BaseChannel *>());
+
+    QVariantMap result;
+    result[QLatin1String("handles")] = handles;
+    result[QLatin1String("presences")] = presences;
+    result[QLatin1String("subscriptions")] = subscriptions;
+    result[QLatin1String("channels")] = channels;
+    result[QLatin1String("pending-messages")] = pendingMessages;
+    result[QLatin1String("total")] = handles + presences + subscriptions + channels + pendingMessages;
+    return result;
 }
 
-void SimpleConnection::onChannelSendMessageRequested(const QString &target, const QString &content)
+void SimpleConnection::onChannelSendMessageRequested(const SimpleCM::Chat &target, const QString &content)
 {
     SimpleCM::Message message;
-    message.chat = SimpleCM::Chat::fromContactId(target);
+    message.account = m_selfId;
+    message.chat = target;
+    SimpleCM::Metrics::increment(SimpleCM::Metrics::MessagesOut);
     message.from = selfID();
     message.text = content;
 
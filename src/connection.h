@@ -19,6 +19,13 @@
 #include <TelepathyQt/BaseConnection>
 #include <TelepathyQt/BaseChannel>
 
+#include <QElapsedTimer>
+#include <QSharedPointer>
+
+#include <functional>
+
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
 class SimpleConnection;
 class SimpleTextChannel;
 
@@ -28,6 +35,7 @@ typedef Tp::SharedPtr<SimpleConnection> SimpleConnectionPtr;
 namespace SimpleCM {
 
 class Chat;
+class ContactNormalizer;
 class Message;
 
 } // SimpleCM
@@ -43,6 +51,9 @@ public:
 
     static Tp::SimpleStatusSpecMap getSimpleStatusSpecMap();
 
+    // The self_id parameter as given by the account (selfID() is its normalized form)
+    QString accountId() const;
+
     void connectCallback(Tp::DBusError *error);
     void onDisconnectRequested();
 
@@ -60,9 +71,58 @@ public:
     uint setPresence(const QString &status, const QString &message, Tp::DBusError *error);
 
     uint ensureContact(const QString &identifier);
+    Tp::UIntList ensureContacts(const QStringList &identifiers);
+    uint ensureRoom(const QString &identifier);
+
+    // The identifiers are normalized before the handle lookup (the invalid ones are used as is)
+    QSharedPointer<SimpleCM::ContactNormalizer> contactNormalizer() const;
+    void setContactNormalizer(const QSharedPointer<SimpleCM::ContactNormalizer> &normalizer);
+    QString normalizeIdentifier(const QString &identifier) const;
+
+    // The roster is restored from the file at connect time and saved on disconnect
+    QString snapshotFileName() const;
+    void setSnapshotFileName(const QString &fileName);
+    bool saveSnapshot(const QString &fileName) const;
+    bool restoreSnapshot(const QString &fileName);
+
+    // Unreferenced handles off the roster are released after the grace period (0 to keep all handles)
+    int handleGracePeriod() const;
+    void setHandleGracePeriod(int msecs);
+    int sweepHandles();
+    QVariantMap handleStatistics() const;
+
+    // The limit counts the contact text channels without pending messages (the room channels and the
+    // channels with pending messages are never closed); above it the least recently active channels idle
+    // for the timeout are closed (0 for no limit)
+    int textChannelLimit() const;
+    void setTextChannelLimit(int limit);
+    int textChannelIdleTimeout() const;
+    void setTextChannelIdleTimeout(int msecs);
+    int evictTextChannels();
+
+    // The text channels of the contacts are created after the connect, one per event loop iteration,
+    // to take the channel setup off the first message of each conversation
+    QStringList hotContacts() const;
+    void setHotContacts(const QStringList &identifiers);
+
+    // Approximate bytes by category; the counters are kept incrementally, only the channels are visited
+    QVariantMap memoryUsage() const;
+
+    // A suspended connection keeps its state and reports a network error until resumed
+    bool isSuspended() const;
+    void suspend();
+    void resume();
+
+    void moveToWorkerThread(QThread *thread);
+    // Runs the function in the connection thread (the connection can live in a service shard)
+    void invoke(const std::function<void()> &function, bool blocking = false);
 
 public slots:
     void receiveMessage(const QString &identifier, const QString &message);
+    void receiveRoomMessage(const QString &room, const QString &sender, const QString &message);
+
+    void addRoomMembers(const QString &room, const QStringList &identifiers);
+    void removeRoomMembers(const QString &room, const QStringList &identifiers);
 
     uint addContact(const QString &identifier);
     uint addContacts(const QStringList &identifiers);
@@ -72,12 +132,20 @@ public slots:
 
 signals:
     void newMessage(const SimpleCM::Message &message);
+    // One signal per presence update call, for all the contacts it changed
+    void contactPresencesChanged(const QString &account, const QStringList &identifiers, const QString &presence);
 
 protected slots:
-    void onChannelSendMessageRequested(const QString &target, const QString &content);
+    void onChannelSendMessageRequested(const SimpleCM::Chat &target, const QString &content);
 
 private:
     uint getHandle(const QString &identifier) const;
+    void touchHandles(const Tp::UIntList &handles);
+    void touchTextChannel(Tp::BaseChannel *channel);
+    bool isEvictable(Tp::BaseChannel *channel) const;
+    void scheduleEviction(int msecs);
+    void startPrewarming();
+    void prewarmNextTextChannel();
 
     void setPresenceState(const QList<uint> &handles, const QString &status);
     void setSubscriptionState(const QStringList &identifiers, const QList<uint> &handles, uint state);
@@ -91,10 +159,51 @@ private:
     Tp::SimpleContactPresences m_presences;
 
     QMap<uint, QString> m_handles;
+    QHash<QString, uint> m_identifiers;
+    /* Rooms have their own handle space */
+    QMap<uint, QString> m_roomHandles;
+    QHash<QString, uint> m_roomIdentifiers;
     /* Maps a contact handle to its subscription state */
     QHash<uint, uint> m_contactsSubscription;
 
+    /* Text channels by their base channel, for the handle references */
+    QHash<Tp::BaseChannel *, SimpleTextChannelPtr> m_textChannels;
+    /* The text channels in the order of their last activity (the least recent first) */
+    QMap<quint64, Tp::BaseChannel *> m_textChannelsByActivity;
+    struct TextChannelActivity {
+        quint64 sequence = 0;
+        qint64 lastActive = 0;
+    };
+    QHash<Tp::BaseChannel *, TextChannelActivity> m_textChannelActivity;
+    quint64 m_activitySequence = 0;
+    QTimer *m_evictionTimer = nullptr;
+    int m_textChannelLimit = 0;
+    /* The contact text channels without pending messages, the ones the limit applies to */
+    int m_evictableTextChannels = 0;
+    int m_textChannelIdleTimeout = 60000;
+    quint64 m_evictedTextChannels = 0;
+    QStringList m_hotContacts;
+    /* The hot contacts still without a channel since the connect */
+    QStringList m_prewarmQueue;
+    QTimer *m_prewarmTimer = nullptr;
+    /* The pre-created text channels by contact handle, until the first message announces them */
+    QHash<uint, Tp::BaseChannelPtr> m_unannouncedTextChannels;
+    quint64 m_prewarmedTextChannels = 0;
+
+    /* The last time the handle was requested or used (for the sweeper grace period) */
+    QHash<uint, qint64> m_handleLastUsed;
+    QElapsedTimer m_clock;
+    QTimer *m_sweepTimer = nullptr;
+    int m_handleGracePeriod = 0;
+    uint m_lastHandle = 0;
+    quint64 m_releasedHandles = 0;
+    /* Identifier string bytes of the contact and room handles */
+    qint64 m_identifierBytes = 0;
+
     QString m_selfId;
+    QString m_snapshotFileName;
+    QSharedPointer<SimpleCM::ContactNormalizer> m_normalizer;
+    bool m_suspended = false;
 };
 
 #endif // SIMPLECM_CONNECTION_H
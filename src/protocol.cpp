@@ -13,6 +13,10 @@
 
 #include "protocol.h"
 #include "connection.h"
+#include "ConnectionShard.hpp"
+#include "ContactNormalizer.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
 
 #include <TelepathyQt/BaseConnection>
 #include <TelepathyQt/Constants>
@@ -20,16 +24,21 @@
 #include <TelepathyQt/RequestableChannelClassSpecList>
 #include <TelepathyQt/Types>
 
+#include <QDir>
 #include <QLatin1String>
+#include <QThread>
+#include <QUrl>
 #include <QVariantMap>
 
 SimpleProtocol::SimpleProtocol(const QDBusConnection &dbusConnection, const QString &name)
     : BaseProtocol(dbusConnection, name)
+    , m_normalizer(new SimpleCM::ContactNormalizer())
 {
     setParameters(Tp::ProtocolParameterList()
                   << Tp::ProtocolParameter(QLatin1String("self_id"), QLatin1String("s"), Tp::ConnMgrParamFlagRequired));
 
-    setRequestableChannelClasses(Tp::RequestableChannelClassSpecList() << Tp::RequestableChannelClassSpec::textChat());
+    setRequestableChannelClasses(Tp::RequestableChannelClassSpecList() << Tp::RequestableChannelClassSpec::textChat()
+                                  << Tp::RequestableChannelClassSpec::textChatroom());
 
     // callbacks
     setCreateConnectionCallback(memFun(this, &SimpleProtocol::createConnection));
@@ -50,6 +59,11 @@ SimpleProtocol::SimpleProtocol(const QDBusConnection &dbusConnection, const QStr
 
 SimpleProtocol::~SimpleProtocol()
 {
+    for (const SimpleConnectionPtr &connection : m_connections) {
+        releaseConnection(connection);
+    }
+    m_connections.clear();
+    qDeleteAll(m_shards);
 }
 
 QString SimpleProtocol::connectionManagerName() const
@@ -62,52 +76,364 @@ void SimpleProtocol::setConnectionManagerName(const QString &newName)
     m_connectionManagerName = newName;
 }
 
-SimpleConnectionPtr SimpleProtocol::getConnection() const
+SimpleConnectionPtr SimpleProtocol::getConnection(const QString &account) const
 {
-    return m_connection;
+    if (account.isEmpty()) {
+        if (m_connections.count() != 1) {
+            return SimpleConnectionPtr();
+        }
+        return m_connections.constBegin().value();
+    }
+
+    return m_connections.value(account);
 }
 
-void SimpleProtocol::addMessage(QString sender, QString message)
+QList<SimpleConnectionPtr> SimpleProtocol::connections() const
 {
-    emit receiveMessage(sender, message);
+    return m_connections.values();
 }
 
-quint32 SimpleProtocol::addContact(const QString &contact)
+int SimpleProtocol::shardCount() const
 {
-    return m_connection->ensureContact(contact);
+    return m_shards.count();
 }
 
-void SimpleProtocol::setContactList(QStringList list)
+bool SimpleProtocol::setShardCount(int count)
 {
-    emit contactsListChanged(list);
+    if (!m_connections.isEmpty()) {
+        qWarning() << Q_FUNC_INFO << "Unable to reshard live connections";
+        return false;
+    }
+
+    qDeleteAll(m_shards);
+    m_shards.clear();
+
+    for (int i = 0; i < count; ++i) {
+        SimpleCM::ConnectionShard *shard = new SimpleCM::ConnectionShard(i);
+        if (!shard->start()) {
+            delete shard;
+            qDeleteAll(m_shards);
+            m_shards.clear();
+            return false;
+        }
+        m_shards.append(shard);
+    }
+
+    return true;
 }
 
-void SimpleProtocol::setContactPresence(const QString &identifier, const QString &presence)
+QSharedPointer<SimpleCM::ContactNormalizer> SimpleProtocol::contactNormalizer() const
 {
-    emit contactPresenceChanged(identifier, presence);
+    return m_normalizer;
 }
 
-void SimpleProtocol::connectionCreatedEvent(SimpleConnectionPtr connection)
+void SimpleProtocol::setContactNormalizer(const QSharedPointer<SimpleCM::ContactNormalizer> &normalizer)
+{
+    m_normalizer = normalizer;
+}
+
+QString SimpleProtocol::snapshotDirectory() const
+{
+    return m_snapshotDirectory;
+}
+
+void SimpleProtocol::setSnapshotDirectory(const QString &directory)
+{
+    m_snapshotDirectory = directory;
+}
+
+int SimpleProtocol::handleGracePeriod() const
+{
+    return m_handleGracePeriod;
+}
+
+void SimpleProtocol::setHandleGracePeriod(int msecs)
+{
+    m_handleGracePeriod = msecs;
+    for (const SimpleConnectionPtr &connection : m_connections) {
+        connection->invoke([connection, msecs]() {
+            connection->setHandleGracePeriod(msecs);
+        });
+    }
+}
+
+int SimpleProtocol::textChannelLimit() const
+{
+    return m_textChannelLimit;
+}
+
+void SimpleProtocol::setTextChannelLimit(int limit)
+{
+    m_textChannelLimit = limit;
+    for (const SimpleConnectionPtr &connection : m_connections) {
+        connection->invoke([connection, limit]() {
+            connection->setTextChannelLimit(limit);
+        });
+    }
+}
+
+int SimpleProtocol::textChannelIdleTimeout() const
+{
+    return m_textChannelIdleTimeout;
+}
+
+void SimpleProtocol::setTextChannelIdleTimeout(int msecs)
+{
+    m_textChannelIdleTimeout = msecs;
+    for (const SimpleConnectionPtr &connection : m_connections) {
+        connection->invoke([connection, msecs]() {
+            connection->setTextChannelIdleTimeout(msecs);
+        });
+    }
+}
+
+QStringList SimpleProtocol::hotContacts(const QString &account) const
+{
+    return m_hotContacts.value(account);
+}
+
+void SimpleProtocol::setHotContacts(const QString &account, const QStringList &identifiers)
+{
+    if (identifiers.isEmpty()) {
+        m_hotContacts.remove(account);
+    } else {
+        m_hotContacts.insert(account, identifiers);
+    }
+
+    SimpleConnectionPtr connection = m_connections.value(account);
+    if (connection) {
+        connection->invoke([connection, identifiers]() {
+            connection->setHotContacts(identifiers);
+        });
+    }
+}
+
+QVariantMap SimpleProtocol::handleStatistics(const QString &account) const
+{
+    SimpleConnectionPtr connection = getConnection(account);
+    if (!connection) {
+        return QVariantMap();
+    }
+
+    QVariantMap result;
+    connection->invoke([connection, &result]() {
+        result = connection->handleStatistics();
+    }, /* blocking */ true);
+    return result;
+}
+
+QVariantMap SimpleProtocol::memoryUsage(const QString &account) const
+{
+    SimpleConnectionPtr connection = getConnection(account);
+    if (!connection) {
+        return QVariantMap();
+    }
+
+    QVariantMap result;
+    connection->invoke([connection, &result]() {
+        result = connection->memoryUsage();
+    }, /* blocking */ true);
+    return result;
+}
+
+void SimpleProtocol::suspendConnections()
+{
+    for (const SimpleConnectionPtr &connection : m_connections) {
+        connection->invoke([connection]() {
+            connection->suspend();
+        });
+    }
+}
+
+void SimpleProtocol::resumeConnections()
+{
+    for (const SimpleConnectionPtr &connection : m_connections) {
+        connection->invoke([connection]() {
+            connection->resume();
+        });
+    }
+}
+
+void SimpleProtocol::addMessage(const QString &account, const QString &sender, const QString &message)
+{
+    SimpleConnectionPtr connection = getConnection(account);
+    if (!connection) {
+        qWarning() << Q_FUNC_INFO << "No connection for account" << account;
+        return;
+    }
+    const qint64 start = SimpleCM::Metrics::now();
+    connection->invoke([connection, sender, message, start]() {
+        connection->receiveMessage(sender, message);
+        SimpleCM::Metrics::recordSince(SimpleCM::Metrics::MessageDeliveryTime, start);
+    });
+}
+
+void SimpleProtocol::addRoomMessage(const QString &account, const QString &room, const QString &sender, const QString &message)
+{
+    SimpleConnectionPtr connection = getConnection(account);
+    if (!connection) {
+        qWarning() << Q_FUNC_INFO << "No connection for account" << account;
+        return;
+    }
+    const qint64 start = SimpleCM::Metrics::now();
+    connection->invoke([connection, room, sender, message, start]() {
+        connection->receiveRoomMessage(room, sender, message);
+        SimpleCM::Metrics::recordSince(SimpleCM::Metrics::MessageDeliveryTime, start);
+    });
+}
+
+void SimpleProtocol::addRoomMembers(const QString &account, const QString &room, const QStringList &members)
+{
+    SimpleConnectionPtr connection = getConnection(account);
+    if (!connection) {
+        qWarning() << Q_FUNC_INFO << "No connection for account" << account;
+        return;
+    }
+    connection->invoke([connection, room, members]() {
+        connection->addRoomMembers(room, members);
+    });
+}
+
+void SimpleProtocol::removeRoomMembers(const QString &account, const QString &room, const QStringList &members)
+{
+    SimpleConnectionPtr connection = getConnection(account);
+    if (!connection) {
+        qWarning() << Q_FUNC_INFO << "No connection for account" << account;
+        return;
+    }
+    connection->invoke([connection, room, members]() {
+        connection->removeRoomMembers(room, members);
+    });
+}
+
+quint32 SimpleProtocol::addContact(const QString &account, const QString &contact)
+{
+    SimpleConnectionPtr connection = getConnection(account);
+    if (!connection) {
+        qWarning() << Q_FUNC_INFO << "No connection for account" << account;
+        return 0;
+    }
+
+    quint32 handle = 0;
+    connection->invoke([connection, contact, &handle]() {
+        handle = connection->ensureContact(contact);
+    }, /* blocking */ true);
+    return handle;
+}
+
+void SimpleProtocol::setContactList(const QString &account, const QStringList &list)
 {
-    connect(this, &SimpleProtocol::receiveMessage,
-            connection.data(), &SimpleConnection::receiveMessage);
-    connect(this, &SimpleProtocol::contactsListChanged,
-            connection.data(), &SimpleConnection::setContactList);
-    connect(this, &SimpleProtocol::contactPresenceChanged,
-            connection.data(), &SimpleConnection::setContactPresence);
+    SimpleConnectionPtr connection = getConnection(account);
+    if (!connection) {
+        qWarning() << Q_FUNC_INFO << "No connection for account" << account;
+        return;
+    }
+    connection->invoke([connection, list]() {
+        connection->setContactList(list);
+    });
+}
+
+void SimpleProtocol::setContactPresence(const QString &account, const QString &identifier, const QString &presence)
+{
+    SimpleConnectionPtr connection = getConnection(account);
+    if (!connection) {
+        qWarning() << Q_FUNC_INFO << "No connection for account" << account;
+        return;
+    }
+    connection->invoke([connection, identifier, presence]() {
+        connection->setContactPresence(identifier, presence);
+    });
+}
 
-    connect(connection.data(), &SimpleConnection::newMessage,
+void SimpleProtocol::connectionCreatedEvent(SimpleConnectionPtr connection)
+{
+    SimpleConnection *connectionObject = connection.data();
+    const QString account = connection->accountId();
+    connect(connectionObject, &SimpleConnection::newMessage,
             this, &SimpleProtocol::newMessage);
+    connect(connectionObject, &SimpleConnection::contactPresencesChanged,
+            this, &SimpleProtocol::contactPresencesChanged);
+    // Queued to not release the last reference to the connection from its own signal
+    connect(connectionObject, &Tp::BaseConnection::disconnected,
+            this, [this, account, connectionObject]() {
+        onConnectionDisconnected(account, connectionObject);
+    }, Qt::QueuedConnection);
 
-    m_connection = connection;
+    m_connections.insert(account, connection);
+
+    // The connection is registered right after it is returned from createConnection()
+    QMetaObject::invokeMethod(this, [this, connection]() {
+        if (connection->isRegistered()) {
+            emit connectionRegistered(connection.data());
+        }
+    }, Qt::QueuedConnection);
+}
+
+void SimpleProtocol::onConnectionDisconnected(const QString &account, SimpleConnection *connection)
+{
+    auto it = m_connections.find(account);
+    if ((it == m_connections.end()) || (it.value().data() != connection)) {
+        // The account has been reconnected already
+        return;
+    }
+    releaseConnection(it.value());
+    m_connections.erase(it);
+}
+
+void SimpleProtocol::releaseConnection(const SimpleConnectionPtr &connection)
+{
+    // The last reference can be dropped from this thread (also by the connection manager), so the connection
+    // and its timers are brought back to be destroyed in the thread they live in
+    QThread *protocolThread = thread();
+    if (connection->thread() != protocolThread) {
+        connection->invoke([connection, protocolThread]() {
+            connection->moveToWorkerThread(protocolThread);
+        }, /* blocking */ true);
+    }
+}
+
+SimpleCM::ConnectionShard *SimpleProtocol::pickShard() const
+{
+    SimpleCM::ConnectionShard *result = nullptr;
+    for (SimpleCM::ConnectionShard *shard : m_shards) {
+        if (!result || (shard->connectionCount() < result->connectionCount())) {
+            result = shard;
+        }
+    }
+    return result;
 }
 
 Tp::BaseConnectionPtr SimpleProtocol::createConnection(const QVariantMap &parameters, Tp::DBusError *error)
 {
     Q_UNUSED(error)
 
-    Tp::BaseConnectionPtr newConnection = Tp::BaseConnection::create<SimpleConnection>(m_connectionManagerName, this->name(), parameters);
+    SimpleCM::ConnectionShard *shard = pickShard();
+    const QDBusConnection dbusConnection = shard ? shard->dbusConnection() : this->dbusConnection();
+
+    Tp::BaseConnectionPtr newConnection = Tp::BaseConnection::create<SimpleConnection>(dbusConnection, m_connectionManagerName, this->name(), parameters);
     SimpleConnectionPtr simpleConnection = SimpleConnectionPtr::dynamicCast(newConnection);
+    simpleConnection->setContactNormalizer(m_normalizer);
+    simpleConnection->setHandleGracePeriod(m_handleGracePeriod);
+    simpleConnection->setTextChannelIdleTimeout(m_textChannelIdleTimeout);
+    simpleConnection->setTextChannelLimit(m_textChannelLimit);
+    simpleConnection->setHotContacts(m_hotContacts.value(simpleConnection->accountId()));
+
+    if (!m_snapshotDirectory.isEmpty()) {
+        const QString fileName = QString::fromLatin1(QUrl::toPercentEncoding(simpleConnection->accountId())) + QLatin1String(".snapshot");
+        simpleConnection->setSnapshotFileName(QDir(m_snapshotDirectory).filePath(fileName));
+    }
+
+    if (shard) {
+        shard->addConnection(simpleConnection.data());
+        // The connection manager registers the connection (and creates the interface adaptors as children
+        // of its D-Bus object) in this thread right after it is returned, so it is moved only afterwards
+        QThread *workerThread = shard->workerThread();
+        QMetaObject::invokeMethod(this, [simpleConnection, workerThread]() {
+            if (simpleConnection->isRegistered()) {
+                simpleConnection->moveToWorkerThread(workerThread);
+            }
+        }, Qt::QueuedConnection);
+    }
 
     connectionCreatedEvent(simpleConnection);
 
@@ -116,29 +442,53 @@ Tp::BaseConnectionPtr SimpleProtocol::createConnection(const QVariantMap &parame
 
 QString SimpleProtocol::identifyAccount(const QVariantMap &parameters, Tp::DBusError *error)
 {
-    qDebug() << Q_FUNC_INFO << parameters;
+    SIMPLECM_TRACE(lcSimpleProtocol) << Q_FUNC_INFO << parameters;
     error->set(QLatin1String("IdentifyAccount.Error.NotImplemented"), QLatin1String(""));
     return QString();
 }
 
 QString SimpleProtocol::normalizeContact(const QString &contactId, Tp::DBusError *error)
 {
-    qDebug() << Q_FUNC_INFO << contactId;
-    error->set(QLatin1String("NormalizeContact.Error.NotImplemented"), QLatin1String(""));
-    return QString();
+    const QString result = m_normalizer->normalize(contactId);
+    if (result.isEmpty()) {
+        error->set(TP_QT_ERROR_INVALID_HANDLE, QLatin1String("Invalid contact identifier: ") + contactId);
+    }
+    return result;
 }
 
 QString SimpleProtocol::normalizeVCardAddress(const QString &vcardField, const QString vcardAddress,
         Tp::DBusError *error)
 {
-    qDebug() << Q_FUNC_INFO << vcardField << vcardAddress;
-    error->set(QLatin1String("NormalizeVCardAddress.Error.NotImplemented"), QLatin1String(""));
-    return QString();
+    QString result;
+    if (vcardField.compare(QLatin1String("tel"), Qt::CaseInsensitive) == 0) {
+        result = SimpleCM::ContactNormalizer::toE164(vcardAddress.trimmed(), m_normalizer->defaultCountryCode());
+    } else {
+        result = m_normalizer->normalize(vcardAddress);
+    }
+    if (result.isEmpty()) {
+        error->set(TP_QT_ERROR_INVALID_ARGUMENT, QLatin1String("Invalid vCard address: ") + vcardAddress);
+    }
+    return result;
 }
 
 QString SimpleProtocol::normalizeContactUri(const QString &uri, Tp::DBusError *error)
 {
-    qDebug() << Q_FUNC_INFO << uri;
-    error->set(QLatin1String("NormalizeContactUri.Error.NotImplemented"), QLatin1String(""));
-    return QString();
+    const int colon = uri.indexOf(QLatin1Char(':'));
+    const QString scheme = uri.left(colon).toLower();
+    if ((colon <= 0) || !addrIface->addressableUriSchemes().contains(scheme, Qt::CaseInsensitive)) {
+        error->set(TP_QT_ERROR_NOT_IMPLEMENTED, QLatin1String("Unsupported URI scheme: ") + uri);
+        return QString();
+    }
+
+    QString identifier = uri.mid(colon + 1);
+    if (scheme == QLatin1String("tel")) {
+        identifier = SimpleCM::ContactNormalizer::toE164(identifier, m_normalizer->defaultCountryCode());
+    } else {
+        identifier = m_normalizer->normalize(identifier);
+    }
+    if (identifier.isEmpty()) {
+        error->set(TP_QT_ERROR_INVALID_ARGUMENT, QLatin1String("Invalid contact URI: ") + uri);
+        return QString();
+    }
+    return scheme + QLatin1Char(':') + identifier;
 }
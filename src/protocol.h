@@ -18,8 +18,14 @@
 
 #include <TelepathyQt/BaseProtocol>
 
+#include <QHash>
+#include <QSharedPointer>
+#include <QVector>
+
 namespace SimpleCM {
 
+class ConnectionShard;
+class ContactNormalizer;
 class Message;
 
 } // SimpleCM
@@ -42,26 +48,62 @@ public:
     QString connectionManagerName() const;
     void setConnectionManagerName(const QString &newName);
 
-    SimpleConnectionPtr getConnection() const;
+    // An empty account means the only connection (if there is exactly one)
+    SimpleConnectionPtr getConnection(const QString &account = QString()) const;
+    QList<SimpleConnectionPtr> connections() const;
+
+    // Connections are distributed over the given number of worker threads (0 to use the protocol thread)
+    int shardCount() const;
+    bool setShardCount(int count);
+
+    // Used by NormalizeContact, the Addressing interface and the new connections
+    QSharedPointer<SimpleCM::ContactNormalizer> contactNormalizer() const;
+    void setContactNormalizer(const QSharedPointer<SimpleCM::ContactNormalizer> &normalizer);
+
+    // A directory for the per-account roster snapshots (empty to disable the snapshots)
+    QString snapshotDirectory() const;
+    void setSnapshotDirectory(const QString &directory);
+
+    // Applied to the existing and the new connections
+    int handleGracePeriod() const;
+    void setHandleGracePeriod(int msecs);
+    int textChannelLimit() const;
+    void setTextChannelLimit(int limit);
+    int textChannelIdleTimeout() const;
+    void setTextChannelIdleTimeout(int msecs);
+    // Applied to the account connection, the existing or the next one
+    QStringList hotContacts(const QString &account) const;
+    void setHotContacts(const QString &account, const QStringList &identifiers);
+    QVariantMap handleStatistics(const QString &account) const;
+    QVariantMap memoryUsage(const QString &account) const;
+
+    void suspendConnections();
+    void resumeConnections();
 
 public slots:
-    void addMessage(QString sender, QString message);
-    quint32 addContact(const QString &contact);
-    void setContactList(QStringList list);
-    void setContactPresence(const QString &identifier, const QString &presence);
+    void addMessage(const QString &account, const QString &sender, const QString &message);
+    void addRoomMessage(const QString &account, const QString &room, const QString &sender, const QString &message);
+    void addRoomMembers(const QString &account, const QString &room, const QStringList &members);
+    void removeRoomMembers(const QString &account, const QString &room, const QStringList &members);
+    quint32 addContact(const QString &account, const QString &contact);
+    void setContactList(const QString &account, const QStringList &list);
+    void setContactPresence(const QString &account, const QString &identifier, const QString &presence);
 
 signals:
     void newMessage(const SimpleCM::Message &message);
+    void contactPresencesChanged(const QString &account, const QStringList &identifiers, const QString &presence);
+
+    // Emitted once a new connection is registered on its bus
+    void connectionRegistered(SimpleConnection *connection);
 
-    void receiveMessage(QString sender, QString message);
-    void contactsListChanged(QStringList list);
     void addContactRequested(const QString &contact);
     void vCardListChanged(QStringList list);
 
-    void contactPresenceChanged(const QString &identifier, const QString &presence);
-
 protected:
     virtual void connectionCreatedEvent(SimpleConnectionPtr connection);
+    void onConnectionDisconnected(const QString &account, SimpleConnection *connection);
+    void releaseConnection(const SimpleConnectionPtr &connection);
+    SimpleCM::ConnectionShard *pickShard() const;
 
 private:
     Tp::BaseConnectionPtr createConnection(const QVariantMap &parameters, Tp::DBusError *error);
@@ -78,7 +120,16 @@ private:
     Tp::BaseProtocolPresenceInterfacePtr presenceIface;
 
     QString m_connectionManagerName;
-    SimpleConnectionPtr m_connection;
+    QString m_snapshotDirectory;
+    QSharedPointer<SimpleCM::ContactNormalizer> m_normalizer;
+    int m_handleGracePeriod = 0;
+    int m_textChannelLimit = 0;
+    int m_textChannelIdleTimeout = 60000;
+    /* The contacts to pre-create the text channels for, by the account self_id */
+    QHash<QString, QStringList> m_hotContacts;
+    /* Live connections by the account self_id */
+    QHash<QString, SimpleConnectionPtr> m_connections;
+    QVector<SimpleCM::ConnectionShard *> m_shards;
 };
 
 #endif // SIMPLECM_PROTOCOL_H
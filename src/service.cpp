@@ -6,47 +6,376 @@
 #include <TelepathyQt/Debug>
 #include <TelepathyQt/Types>
 
+#include <QDebug>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
+
 #include "Chat.hpp"
+#include "connection.h"
+#include "ContactNormalizer.hpp"
+#include "MemoryUsage.hpp"
 #include "Message.hpp"
+#include "Metrics.hpp"
+#include "MetricsAdaptor.hpp"
 #include "protocol.h"
 #include "ServiceLowLevel_p.h"
+#include "Trace.hpp"
+#include "TrafficRecorder.hpp"
+
+#include <memory>
 
 enum class ServiceState {
     Initial,
     Prepared,
     Running,
+    Suspended, // The objects stay registered and the host calls are queued
+    Resuming, // The queued host calls are being replayed
 };
 
 namespace SimpleCM {
 
+// Queued host calls replayed per event loop iteration on resume
+static const int c_resumeBatchSize = 64;
+// Identifiers resolved per event loop iteration of the connection thread
+static const int c_resolveChunkSize = 4096;
+
+class PendingHostCall
+{
+public:
+    enum Type {
+        AddMessage,
+        SetContactList,
+        SetContactPresence,
+        AddRoomMembers,
+        RemoveRoomMembers,
+    };
+
+    Type type = AddMessage;
+    QString account;
+    Message message; // AddMessage
+    QStringList contacts; // SetContactList, AddRoomMembers, RemoveRoomMembers
+    QSet<QString> contactSet; // SetContactList
+    QString identifier; // SetContactPresence (contact), AddRoomMembers and RemoveRoomMembers (room)
+    QString presence; // SetContactPresence
+    bool superseded = false; // Merged into a later call of the queue
+};
+
+class PendingResolve
+{
+public:
+    quint32 id = 0;
+    QStringList identifiers;
+};
+
+/* The pending requests of an account resolved in a single pass */
+class ContactsResolution
+{
+public:
+    QString account;
+    QVector<PendingResolve> requests;
+    QStringList identifiers;
+    QList<quint32> handles;
+};
+
 class ServicePrivate
 {
 public:
+    bool registerMetricsObject();
+    QString metricsObjectPath() const;
+
+    bool isQueueing() const;
+    void queueContactList(const QString &account, const QStringList &list);
+    void queueContactPresence(const QString &account, const QString &identifier, const QString &presence);
+    void queueMessage(const QString &account, const Message &message);
+    void queueRoomMembers(PendingHostCall::Type type, const QString &account, const QString &room, const QStringList &members);
+    PendingHostCall supersede(int index);
+    void deliverMessage(const QString &account, const Message &message);
+    static qint64 messageBytes(const Message &message);
+    void clearQueue();
+    void apply(const PendingHostCall &call);
+
+    void dispatchResolves(const QString &account, const SimpleConnectionPtr &connection);
+    void onConnectionRegistered(SimpleConnection *connection);
+    void resolveChunk(const SimpleConnectionPtr &connection, const std::shared_ptr<ContactsResolution> &resolution);
+    void finishResolution(const ContactsResolution &resolution);
+
+    Service *service = nullptr;
     ServiceState state = ServiceState::Initial;
     QString selfContactId;
     QString cmName;
     QString protocolName;
+    int shardCount = 0;
+    QString snapshotDirectory;
+    int handleGracePeriod = 0;
+    int textChannelLimit = 0;
+    int textChannelIdleTimeout = 60000;
+    QHash<QString, QStringList> hotContacts;
+    bool metricsInterfaceEnabled = false;
+    QObject *metricsObject = nullptr;
+    QSharedPointer<ContactNormalizer> normalizer;
     SimpleProtocol *protocol = nullptr;
     ServiceLowLevel *lowLevel = nullptr;
     ServiceLowLevelPrivate *lowLevelData = nullptr;
+    TrafficRecorder *recorder = nullptr;
+
+    QVector<PendingHostCall> pendingCalls;
+    int replayedCalls = 0;
+    // Indices of the calls not yet replayed that the newer calls are merged into
+    QHash<QString, int> pendingContactLists;
+    QHash<QPair<QString, QString>, int> pendingPresences;
+    // Bytes of the queued messages by account
+    QHash<QString, qint64> queuedMessageBytes;
+    QTimer *resumeTimer = nullptr;
+
+    // Handle resolution requests waiting for the connection of the account
+    QHash<QString, QVector<PendingResolve>> pendingResolves;
+    quint32 lastResolveId = 0;
 };
 
+void ServicePrivate::dispatchResolves(const QString &account, const SimpleConnectionPtr &connection)
+{
+    const QVector<PendingResolve> requests = pendingResolves.take(account);
+    if (requests.isEmpty()) {
+        return;
+    }
+
+    std::shared_ptr<ContactsResolution> resolution = std::make_shared<ContactsResolution>();
+    resolution->account = account;
+    resolution->requests = requests;
+    for (const PendingResolve &request : requests) {
+        resolution->identifiers += request.identifiers;
+    }
+    resolution->handles.reserve(resolution->identifiers.count());
+
+    resolveChunk(connection, resolution);
+}
+
+void ServicePrivate::onConnectionRegistered(SimpleConnection *connection)
+{
+    const QStringList accounts = pendingResolves.keys();
+    for (const QString &account : accounts) {
+        const SimpleConnectionPtr accountConnection = protocol->getConnection(account);
+        if (accountConnection.data() == connection) {
+            dispatchResolves(account, accountConnection);
+        }
+    }
+}
+
+void ServicePrivate::resolveChunk(const SimpleConnectionPtr &connection, const std::shared_ptr<ContactsResolution> &resolution)
+{
+    // One chunk at a time with the service event loop running in between to not block it on huge lists.
+    // The chunk is resolved with a blocking call that keeps the connection referenced and never touches
+    // the service from the connection thread (the service can be destroyed meanwhile).
+    const int offset = resolution->handles.count();
+    const QStringList identifiers = resolution->identifiers.mid(offset, c_resolveChunkSize);
+    Tp::UIntList handles;
+    connection->invoke([connection, identifiers, &handles]() {
+        handles = connection->ensureContacts(identifiers);
+    }, /* blocking */ true);
+    resolution->handles += handles;
+
+    if (resolution->handles.count() >= resolution->identifiers.count()) {
+        finishResolution(*resolution);
+        return;
+    }
+    QMetaObject::invokeMethod(service, [this, connection, resolution]() {
+        resolveChunk(connection, resolution);
+    }, Qt::QueuedConnection);
+}
+
+void ServicePrivate::finishResolution(const ContactsResolution &resolution)
+{
+    int offset = 0;
+    for (const PendingResolve &request : resolution.requests) {
+        const int count = request.identifiers.count();
+        emit service->contactsResolved(request.id, resolution.account, request.identifiers,
+                                       resolution.handles.mid(offset, count));
+        offset += count;
+    }
+}
+
+bool ServicePrivate::isQueueing() const
+{
+    return (state == ServiceState::Suspended) || (state == ServiceState::Resuming);
+}
+
+void ServicePrivate::queueContactList(const QString &account, const QStringList &list)
+{
+    // The contact lists are additive, so the pending ones of an account are merged into one call.
+    // The merged call takes the position of the latest one to keep the order of the host calls.
+    PendingHostCall call;
+    const int index = pendingContactLists.value(account, -1);
+    if (index >= replayedCalls) {
+        call = supersede(index);
+    } else {
+        call.type = PendingHostCall::SetContactList;
+        call.account = account;
+    }
+    for (const QString &contact : list) {
+        if (!call.contactSet.contains(contact)) {
+            call.contactSet.insert(contact);
+            call.contacts.append(contact);
+        }
+    }
+    pendingContactLists.insert(account, pendingCalls.count());
+    pendingCalls.append(call);
+}
+
+void ServicePrivate::queueContactPresence(const QString &account, const QString &identifier, const QString &presence)
+{
+    // Only the latest presence of a contact matters, at the position of the latest call
+    const QPair<QString, QString> key(account, identifier);
+    const int index = pendingPresences.value(key, -1);
+    if (index >= replayedCalls) {
+        supersede(index);
+    }
+
+    PendingHostCall call;
+    call.type = PendingHostCall::SetContactPresence;
+    call.account = account;
+    call.identifier = identifier;
+    call.presence = presence;
+    pendingPresences.insert(key, pendingCalls.count());
+    pendingCalls.append(call);
+}
+
+PendingHostCall ServicePrivate::supersede(int index)
+{
+    // The slot stays in the queue (the indices of the other calls are kept) but is skipped on replay
+    PendingHostCall &call = pendingCalls[index];
+    const PendingHostCall result = call;
+    call = PendingHostCall();
+    call.superseded = true;
+    return result;
+}
+
+void ServicePrivate::queueMessage(const QString &account, const Message &message)
+{
+    PendingHostCall call;
+    call.type = PendingHostCall::AddMessage;
+    call.account = account;
+    call.message = message;
+    pendingCalls.append(call);
+    queuedMessageBytes[account] += messageBytes(message);
+}
+
+void ServicePrivate::queueRoomMembers(PendingHostCall::Type type, const QString &account, const QString &room, const QStringList &members)
+{
+    PendingHostCall call;
+    call.type = type;
+    call.account = account;
+    call.identifier = room;
+    call.contacts = members;
+    pendingCalls.append(call);
+}
+
+qint64 ServicePrivate::messageBytes(const Message &message)
+{
+    return static_cast<qint64>(sizeof(PendingHostCall))
+            + MemoryUsage::stringBytes(message.chat.identifier)
+            + MemoryUsage::stringBytes(message.from)
+            + MemoryUsage::stringBytes(message.text);
+}
+
+void ServicePrivate::deliverMessage(const QString &account, const Message &message)
+{
+    if (!protocol) {
+        qWarning() << Q_FUNC_INFO << "The service is not started";
+        return;
+    }
+    if (message.chat.type == Chat::Room) {
+        protocol->addRoomMessage(account, message.chat.identifier, message.from, message.text);
+    } else {
+        protocol->addMessage(account, message.chat.identifier, message.text);
+    }
+}
+
+void ServicePrivate::clearQueue()
+{
+    if (resumeTimer) {
+        resumeTimer->stop();
+    }
+    pendingCalls.clear();
+    replayedCalls = 0;
+    pendingContactLists.clear();
+    pendingPresences.clear();
+    queuedMessageBytes.clear();
+}
+
+void ServicePrivate::apply(const PendingHostCall &call)
+{
+    if (call.superseded) {
+        return;
+    }
+    switch (call.type) {
+    case PendingHostCall::AddMessage:
+        queuedMessageBytes[call.account] -= messageBytes(call.message);
+        deliverMessage(call.account, call.message);
+        break;
+    case PendingHostCall::SetContactList:
+        protocol->setContactList(call.account, call.contacts);
+        break;
+    case PendingHostCall::SetContactPresence:
+        protocol->setContactPresence(call.account, call.identifier, call.presence);
+        break;
+    case PendingHostCall::AddRoomMembers:
+        protocol->addRoomMembers(call.account, call.identifier, call.contacts);
+        break;
+    case PendingHostCall::RemoveRoomMembers:
+        protocol->removeRoomMembers(call.account, call.identifier, call.contacts);
+        break;
+    }
+}
+
+QString ServicePrivate::metricsObjectPath() const
+{
+    return lowLevelData->connectionManager->objectPath() + QLatin1String("/Debug/Metrics");
+}
+
+bool ServicePrivate::registerMetricsObject()
+{
+    metricsObject = new QObject();
+    new MetricsAdaptor(metricsObject);
+
+    QDBusConnection bus = lowLevelData->connectionManager->dbusConnection();
+    if (!bus.registerObject(metricsObjectPath(), metricsObject)) {
+        qWarning() << Q_FUNC_INFO << "Unable to register the metrics object";
+        delete metricsObject;
+        metricsObject = nullptr;
+        return false;
+    }
+    return true;
+}
+
 Service::Service(QObject *parent)
     : QObject(parent)
 {
     m_d = new ServicePrivate();
+    m_d->service = this;
+    m_d->normalizer.reset(new ContactNormalizer());
     m_d->lowLevel = ServiceLowLevelPrivate::createLowLevel(this);
     m_d->lowLevelData = ServiceLowLevelPrivate::get(m_d->lowLevel);
+    m_d->resumeTimer = new QTimer(this);
+    connect(m_d->resumeTimer, &QTimer::timeout, this, &Service::replayPendingCalls);
 
+    qRegisterMetaType<SimpleCM::Message>();
     Tp::registerTypes();
-    Tp::enableDebug(true);
+    // Enable with QT_LOGGING_RULES="simple.telepathy.debug=true"
+    Tp::enableDebug(lcSimpleTelepathy().isDebugEnabled());
     Tp::enableWarnings(true);
 }
 
 bool Service::isRunning() const
 {
     Q_D(const Service);
-    return d->state == ServiceState::Running;
+    return (d->state == ServiceState::Running) || (d->state == ServiceState::Resuming);
+}
+
+bool Service::isSuspended() const
+{
+    Q_D(const Service);
+    return d->state == ServiceState::Suspended;
 }
 
 QString Service::selfContactIdentifier() const
@@ -55,6 +384,215 @@ QString Service::selfContactIdentifier() const
     return d->selfContactId;
 }
 
+QStringList Service::accounts() const
+{
+    Q_D(const Service);
+    QStringList result;
+    if (!d->protocol) {
+        return result;
+    }
+    for (const SimpleConnectionPtr &connection : d->protocol->connections()) {
+        result << connection->accountId();
+    }
+    return result;
+}
+
+int Service::shardCount() const
+{
+    Q_D(const Service);
+    return d->shardCount;
+}
+
+void Service::setShardCount(int count)
+{
+    Q_D(Service);
+    d->shardCount = qMax(0, count);
+}
+
+QString Service::snapshotDirectory() const
+{
+    Q_D(const Service);
+    return d->snapshotDirectory;
+}
+
+void Service::setSnapshotDirectory(const QString &directory)
+{
+    Q_D(Service);
+    d->snapshotDirectory = directory;
+    if (d->protocol) {
+        d->protocol->setSnapshotDirectory(directory);
+    }
+}
+
+int Service::handleGracePeriod() const
+{
+    Q_D(const Service);
+    return d->handleGracePeriod;
+}
+
+void Service::setHandleGracePeriod(int msecs)
+{
+    Q_D(Service);
+    d->handleGracePeriod = qMax(0, msecs);
+    if (d->protocol) {
+        d->protocol->setHandleGracePeriod(d->handleGracePeriod);
+    }
+}
+
+int Service::textChannelLimit() const
+{
+    Q_D(const Service);
+    return d->textChannelLimit;
+}
+
+void Service::setTextChannelLimit(int limit)
+{
+    Q_D(Service);
+    d->textChannelLimit = qMax(0, limit);
+    if (d->protocol) {
+        d->protocol->setTextChannelLimit(d->textChannelLimit);
+    }
+}
+
+int Service::textChannelIdleTimeout() const
+{
+    Q_D(const Service);
+    return d->textChannelIdleTimeout;
+}
+
+void Service::setTextChannelIdleTimeout(int msecs)
+{
+    Q_D(Service);
+    d->textChannelIdleTimeout = qMax(0, msecs);
+    if (d->protocol) {
+        d->protocol->setTextChannelIdleTimeout(d->textChannelIdleTimeout);
+    }
+}
+
+QStringList Service::hotContacts() const
+{
+    Q_D(const Service);
+    return hotContacts(d->selfContactId);
+}
+
+QStringList Service::hotContacts(const QString &account) const
+{
+    Q_D(const Service);
+    return d->hotContacts.value(account);
+}
+
+void Service::setHotContacts(const QStringList &identifiers)
+{
+    Q_D(Service);
+    setHotContacts(d->selfContactId, identifiers);
+}
+
+void Service::setHotContacts(const QString &account, const QStringList &identifiers)
+{
+    Q_D(Service);
+    if (identifiers.isEmpty()) {
+        d->hotContacts.remove(account);
+    } else {
+        d->hotContacts.insert(account, identifiers);
+    }
+    if (d->protocol) {
+        d->protocol->setHotContacts(account, identifiers);
+    }
+}
+
+QVariantMap Service::handleStatistics() const
+{
+    Q_D(const Service);
+    return handleStatistics(d->selfContactId);
+}
+
+QVariantMap Service::handleStatistics(const QString &account) const
+{
+    Q_D(const Service);
+    if (!d->protocol) {
+        return QVariantMap();
+    }
+    return d->protocol->handleStatistics(account);
+}
+
+QVariantMap Service::memoryUsage() const
+{
+    Q_D(const Service);
+    return memoryUsage(d->selfContactId);
+}
+
+QVariantMap Service::memoryUsage(const QString &account) const
+{
+    Q_D(const Service);
+    if (!d->protocol) {
+        return QVariantMap();
+    }
+
+    QVariantMap result = d->protocol->memoryUsage(account);
+    const qint64 queuedMessages = d->queuedMessageBytes.value(account);
+    if (result.isEmpty() && !queuedMessages) {
+        return result;
+    }
+    result[QLatin1String("queued-messages")] = queuedMessages;
+    result[QLatin1String("total")] = result.value(QLatin1String("total")).toLongLong() + queuedMessages;
+    return result;
+}
+
+QVariantMap Service::metrics() const
+{
+    return Metrics::snapshot();
+}
+
+void Service::resetMetrics()
+{
+    Metrics::reset();
+}
+
+bool Service::isMetricsInterfaceEnabled() const
+{
+    Q_D(const Service);
+    return d->metricsInterfaceEnabled;
+}
+
+void Service::setMetricsInterfaceEnabled(bool enabled)
+{
+    Q_D(Service);
+    d->metricsInterfaceEnabled = enabled;
+}
+
+void Service::startTracing(int capacity)
+{
+    Trace::start(capacity);
+}
+
+bool Service::stopTracing(const QString &fileName)
+{
+    Trace::stop();
+    if (fileName.isEmpty()) {
+        return true;
+    }
+    return Trace::writeChromeTrace(fileName);
+}
+
+ContactNormalizer *Service::contactNormalizer() const
+{
+    Q_D(const Service);
+    return d->normalizer.data();
+}
+
+TrafficRecorder *Service::trafficRecorder() const
+{
+    Q_D(const Service);
+    return d->recorder;
+}
+
+void Service::setTrafficRecorder(TrafficRecorder *recorder)
+{
+    Q_D(Service);
+    d->recorder = recorder;
+    d->lowLevelData->recorder = recorder;
+}
+
 ServiceLowLevel *Service::lowLevel()
 {
     return m_d->lowLevel;
@@ -79,6 +617,21 @@ bool Service::prepare()
 
     m_d->protocol = static_cast<SimpleProtocol*>(baseProtocol.data());
     m_d->protocol->setConnectionManagerName(m_d->cmName);
+    m_d->protocol->setSnapshotDirectory(m_d->snapshotDirectory);
+    m_d->protocol->setContactNormalizer(m_d->normalizer);
+    m_d->protocol->setHandleGracePeriod(m_d->handleGracePeriod);
+    m_d->protocol->setTextChannelIdleTimeout(m_d->textChannelIdleTimeout);
+    m_d->protocol->setTextChannelLimit(m_d->textChannelLimit);
+    for (auto it = m_d->hotContacts.constBegin(); it != m_d->hotContacts.constEnd(); ++it) {
+        m_d->protocol->setHotContacts(it.key(), it.value());
+    }
+    if (!m_d->protocol->setShardCount(m_d->shardCount)) {
+        qWarning() << Q_FUNC_INFO << "Unable to start the service shards";
+        connectionManager.reset();
+        baseProtocol.reset();
+        m_d->protocol = nullptr;
+        return false;
+    }
     connectionManager->addProtocol(baseProtocol);
 
     m_d->state = ServiceState::Prepared;
@@ -101,13 +654,78 @@ bool Service::start()
 
     connect(m_d->protocol, &SimpleProtocol::newMessage,
             this, &Service::newMessage);
+    connect(m_d->protocol, &SimpleProtocol::contactPresencesChanged,
+            this, &Service::contactPresencesChanged);
+    connect(m_d->protocol, &SimpleProtocol::connectionRegistered,
+            this, [this](SimpleConnection *connection) {
+        m_d->onConnectionRegistered(connection);
+    });
+
+    if (!m_d->lowLevelData->connectionManager->registerObject()) {
+        return false;
+    }
+
+    if (m_d->metricsInterfaceEnabled && !m_d->registerMetricsObject()) {
+        return false;
+    }
+
+    return true;
+}
 
-    return m_d->lowLevelData->connectionManager->registerObject();
+bool Service::suspend()
+{
+    Q_D(Service);
+    if (d->state == ServiceState::Resuming) {
+        d->resumeTimer->stop();
+    } else if (d->state != ServiceState::Running) {
+        return false;
+    }
+
+    d->state = ServiceState::Suspended;
+    d->protocol->suspendConnections();
+    return true;
+}
+
+bool Service::resume()
+{
+    Q_D(Service);
+    if (d->state != ServiceState::Suspended) {
+        return false;
+    }
+
+    d->state = ServiceState::Resuming;
+    d->protocol->resumeConnections();
+    d->resumeTimer->start(0);
+    return true;
+}
+
+void Service::replayPendingCalls()
+{
+    Q_D(Service);
+    const int batchEnd = qMin(d->replayedCalls + c_resumeBatchSize, d->pendingCalls.count());
+    while (d->replayedCalls < batchEnd) {
+        d->apply(d->pendingCalls.at(d->replayedCalls));
+        ++d->replayedCalls;
+    }
+
+    if (d->replayedCalls < d->pendingCalls.count()) {
+        return;
+    }
+
+    d->clearQueue();
+    d->state = ServiceState::Running;
+    emit resumed();
 }
 
 bool Service::stop()
 {
     Q_D(Service);
+    d->clearQueue();
+    if (d->metricsObject) {
+        d->lowLevelData->connectionManager->dbusConnection().unregisterObject(d->metricsObjectPath());
+        delete d->metricsObject;
+        d->metricsObject = nullptr;
+    }
     d->lowLevelData->connectionManager.reset();
     d->lowLevelData->baseProtocol.reset();
     d->protocol = nullptr;
@@ -137,25 +755,145 @@ void Service::setProtocolName(const QString &name)
 quint32 Service::addContact(const QString &contact)
 {
     Q_D(Service);
-    return d->protocol->addContact(contact);
+    return addContact(d->selfContactId, contact);
+}
+
+quint32 Service::addContact(const QString &account, const QString &contact)
+{
+    Q_D(Service);
+    if (!d->protocol) {
+        qWarning() << Q_FUNC_INFO << "The service is not started";
+        return 0;
+    }
+    return d->protocol->addContact(account, contact);
+}
+
+quint32 Service::resolveContacts(const QStringList &identifiers)
+{
+    Q_D(Service);
+    return resolveContacts(d->selfContactId, identifiers);
+}
+
+quint32 Service::resolveContacts(const QString &account, const QStringList &identifiers)
+{
+    Q_D(Service);
+    PendingResolve request;
+    request.id = ++d->lastResolveId;
+    request.identifiers = identifiers;
+    d->pendingResolves[account].append(request);
+
+    // Dispatch later to let the caller connect to the signal and to batch the requests made in a row
+    QMetaObject::invokeMethod(this, [d, account]() {
+        if (!d->protocol) {
+            return;
+        }
+        const SimpleConnectionPtr connection = d->protocol->getConnection(account);
+        if (connection && connection->isRegistered()) {
+            d->dispatchResolves(account, connection);
+        }
+    }, Qt::QueuedConnection);
+
+    return request.id;
 }
 
 void Service::setContactList(const QStringList &list)
 {
     Q_D(Service);
-    d->protocol->setContactList(list);
+    setContactList(d->selfContactId, list);
+}
+
+void Service::setContactList(const QString &account, const QStringList &list)
+{
+    Q_D(Service);
+    if (d->recorder) {
+        d->recorder->recordContactList(account, list);
+    }
+    if (d->isQueueing()) {
+        d->queueContactList(account, list);
+        return;
+    }
+    if (!d->protocol) {
+        qWarning() << Q_FUNC_INFO << "The service is not started";
+        return;
+    }
+    d->protocol->setContactList(account, list);
 }
 
 void Service::setContactPresence(const QString &identifier, const QString &presence)
 {
     Q_D(Service);
-    d->protocol->setContactPresence(identifier, presence);
+    setContactPresence(d->selfContactId, identifier, presence);
+}
+
+void Service::setContactPresence(const QString &account, const QString &identifier, const QString &presence)
+{
+    Q_D(Service);
+    if (d->recorder) {
+        d->recorder->recordContactPresence(account, identifier, presence);
+    }
+    if (d->isQueueing()) {
+        d->queueContactPresence(account, identifier, presence);
+        return;
+    }
+    if (!d->protocol) {
+        qWarning() << Q_FUNC_INFO << "The service is not started";
+        return;
+    }
+    d->protocol->setContactPresence(account, identifier, presence);
 }
 
 void Service::addMessage(const Message &message)
 {
     Q_D(Service);
-    d->protocol->addMessage(message.chat.identifier, message.text);
+    if (d->recorder) {
+        d->recorder->recordMessage(message);
+    }
+    const QString account = message.account.isEmpty() ? d->selfContactId : message.account;
+    if (d->isQueueing()) {
+        d->queueMessage(account, message);
+        return;
+    }
+    d->deliverMessage(account, message);
+}
+
+void Service::addRoomMembers(const QString &room, const QStringList &members)
+{
+    Q_D(Service);
+    addRoomMembers(d->selfContactId, room, members);
+}
+
+void Service::addRoomMembers(const QString &account, const QString &room, const QStringList &members)
+{
+    Q_D(Service);
+    if (d->isQueueing()) {
+        d->queueRoomMembers(PendingHostCall::AddRoomMembers, account, room, members);
+        return;
+    }
+    if (!d->protocol) {
+        qWarning() << Q_FUNC_INFO << "The service is not started";
+        return;
+    }
+    d->protocol->addRoomMembers(account, room, members);
+}
+
+void Service::removeRoomMembers(const QString &room, const QStringList &members)
+{
+    Q_D(Service);
+    removeRoomMembers(d->selfContactId, room, members);
+}
+
+void Service::removeRoomMembers(const QString &account, const QString &room, const QStringList &members)
+{
+    Q_D(Service);
+    if (d->isQueueing()) {
+        d->queueRoomMembers(PendingHostCall::RemoveRoomMembers, account, room, members);
+        return;
+    }
+    if (!d->protocol) {
+        qWarning() << Q_FUNC_INFO << "The service is not started";
+        return;
+    }
+    d->protocol->removeRoomMembers(account, room, members);
 }
 
 } // SimpleCM
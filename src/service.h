@@ -2,15 +2,19 @@
 #define SIMPLESERVICE_H
 
 #include <QObject>
+#include <QStringList>
+#include <QVariantMap>
 
 #include "simplecm_export.h"
 
 namespace SimpleCM {
 
+class ContactNormalizer;
 class Message;
 
 class ServiceLowLevel;
 class ServicePrivate;
+class TrafficRecorder;
 class SIMPLECM_EXPORT Service : public QObject
 {
     Q_OBJECT
@@ -18,8 +22,69 @@ public:
     explicit Service(QObject *parent = nullptr);
 
     bool isRunning() const;
+    bool isSuspended() const;
 
     QString selfContactIdentifier() const;
+    QStringList accounts() const;
+
+    // Number of worker threads (each with its own D-Bus connection) to distribute the connections
+    int shardCount() const;
+    void setShardCount(int count);
+
+    // Rosters are persisted per account in the directory for warm restarts (empty to disable)
+    QString snapshotDirectory() const;
+    void setSnapshotDirectory(const QString &directory);
+
+    // Handles unused for the period that are off the roster and not referenced by a channel are released
+    // (0, the default, keeps all handles)
+    int handleGracePeriod() const;
+    void setHandleGracePeriod(int msecs);
+
+    // Above the limit of open contact text channels per connection the least recently active ones, idle for
+    // the timeout and without pending messages, are closed. The room channels and the channels with pending
+    // messages are not counted (0, the default, keeps all channels open)
+    int textChannelLimit() const;
+    void setTextChannelLimit(int limit);
+    int textChannelIdleTimeout() const;
+    void setTextChannelIdleTimeout(int msecs);
+
+    // The text channels of the account's most active contacts are created once it connects, one per event
+    // loop iteration, so that the first message of those conversations does not pay for the channel setup.
+    // The channels are announced to the clients as incoming chats only when the first message arrives.
+    // The overloads without an account address the selfContactIdentifier() account.
+    QStringList hotContacts() const;
+    QStringList hotContacts(const QString &account) const;
+    void setHotContacts(const QStringList &identifiers);
+    void setHotContacts(const QString &account, const QStringList &identifiers);
+
+    // Handle and contact counts of the account connection (empty if there is no connection)
+    QVariantMap handleStatistics() const;
+    QVariantMap handleStatistics(const QString &account) const;
+
+    // Approximate bytes of the account connection by category (handles, presences, subscriptions,
+    // channels, pending-messages) and of the inbound messages queued while suspended (queued-messages).
+    // Outbound messages are handed to the host by the newMessage() signal and are never queued.
+    QVariantMap memoryUsage() const;
+    QVariantMap memoryUsage(const QString &account) const;
+
+    // Process-wide counters, gauges and latency histograms (in nanoseconds)
+    QVariantMap metrics() const;
+    void resetMetrics();
+
+    // Exposes the metrics on the bus as a read-only SimpleCM.Debug.Metrics object under the connection manager path
+    bool isMetricsInterfaceEnabled() const;
+    void setMetricsInterfaceEnabled(bool enabled);
+
+    // Records the durations of the hot paths into a ring buffer of the given size (process-wide)
+    void startTracing(int capacity = 65536);
+    // Stops the recording and writes the trace (chrome://tracing, Perfetto) if the fileName is not empty
+    bool stopTracing(const QString &fileName = QString());
+
+    // The identifiers normalization of the protocol (owned by the service)
+    ContactNormalizer *contactNormalizer() const;
+
+    TrafficRecorder *trafficRecorder() const;
+    void setTrafficRecorder(TrafficRecorder *recorder);
 
 #if defined(BUILD_SIMPLECM_LIB) || defined(SIMPLECM_ENABLE_LOWLEVEL_API)
     bool prepare();
@@ -29,21 +94,57 @@ public:
 signals:
     void newMessage(const Message &message);
 
+    // The presence of the account contacts was set (by the host or as "unknown" for the new contacts),
+    // once per update for all the contacts it changed
+    void contactPresencesChanged(const QString &account, const QStringList &identifiers, const QString &presence);
+
+    // Emitted once the host calls queued while suspended are replayed
+    void resumed();
+
+    // The handles are in the order of the requested identifiers
+    void contactsResolved(quint32 requestId, const QString &account,
+                          const QStringList &identifiers, const QList<quint32> &handles);
+
 public slots:
     bool start();
     bool stop();
 
+    // Keeps the connections and channels but reports a network error to the clients.
+    // The host calls are queued (coalesced per contact) and replayed in batches on resume.
+    // addContact() is not queued since it only allocates a handle.
+    bool suspend();
+    bool resume();
+
     void setSelfContactIdentifier(const QString &selfId);
 
     void setManagerName(const QString &name);
     void setProtocolName(const QString &name);
 
+    // The overloads without an account address the selfContactIdentifier() account
     quint32 addContact(const QString &contact);
+    quint32 addContact(const QString &account, const QString &contact);
+
+    // Resolves the identifiers to handles without blocking and returns the request id for contactsResolved().
+    // The requests made before the account connection exists are resolved in one pass once it is registered.
+    quint32 resolveContacts(const QStringList &identifiers);
+    quint32 resolveContacts(const QString &account, const QStringList &identifiers);
     void setContactList(const QStringList &list);
+    void setContactList(const QString &account, const QStringList &list);
     void setContactPresence(const QString &identifier, const QString &presence);
+    void setContactPresence(const QString &account, const QString &identifier, const QString &presence);
 
+    // Messages to a Room chat are from the message.from member
     void addMessage(const Message &message);
 
+    // The members of a batch are announced with a single MembersChanged signal
+    void addRoomMembers(const QString &room, const QStringList &members);
+    void addRoomMembers(const QString &account, const QString &room, const QStringList &members);
+    void removeRoomMembers(const QString &room, const QStringList &members);
+    void removeRoomMembers(const QString &account, const QString &room, const QStringList &members);
+
+protected slots:
+    void replayPendingCalls();
+
 protected:
     ServicePrivate *m_d = nullptr;
     Q_DECLARE_PRIVATE_D(m_d, Service)
@@ -13,6 +13,10 @@
 
 #include "textchannel.h"
 
+#include "MemoryUsage.hpp"
+#include "Metrics.hpp"
+
+#include <TelepathyQt/BaseConnection>
 #include <TelepathyQt/Constants>
 #include <TelepathyQt/RequestableChannelClassSpec>
 #include <TelepathyQt/RequestableChannelClassSpecList>
@@ -23,6 +27,41 @@
 
 #include <QDebug>
 
+#include <algorithm>
+#include <iterator>
+
+// The base channel with its interfaces and D-Bus adaptors (a rough estimate)
+static const qint64 c_baseChannelBytes = 2048;
+
+static qint64 messageBytes(const Tp::MessagePartList &partList)
+{
+    using namespace SimpleCM::MemoryUsage;
+
+    qint64 bytes = partList.count() * static_cast<qint64>(sizeof(Tp::MessagePart));
+    for (const Tp::MessagePart &part : partList) {
+        for (auto it = part.constBegin(); it != part.constEnd(); ++it) {
+            bytes += mapEntryBytes<QString, QDBusVariant>() + stringBytes(it.key());
+            const QVariant value = it.value().variant();
+            if (value.type() == QVariant::String) {
+                bytes += stringBytes(value.toString());
+            }
+        }
+    }
+    return bytes;
+}
+
+static QVector<uint> sortedHandles(const Tp::UIntList &handles)
+{
+    QVector<uint> result;
+    result.reserve(handles.count());
+    for (uint handle : handles) {
+        result.append(handle);
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
 SimpleTextChannel::SimpleTextChannel(Tp::BaseChannel *baseChannel)
     : Tp::BaseChannelTextType(baseChannel),
       m_targetHandle(baseChannel->targetHandle()),
@@ -43,6 +82,18 @@ SimpleTextChannel::SimpleTextChannel(Tp::BaseChannel *baseChannel)
     baseChannel->plugInterface(Tp::AbstractChannelInterfacePtr::dynamicCast(m_messagesIface));
 
     m_messagesIface->setSendMessageCallback(Tp::memFun(this, &SimpleTextChannel::sendMessageCallback));
+    setMessageAcknowledgedCallback(Tp::memFun(this, &SimpleTextChannel::messageAcknowledged));
+
+    if (baseChannel->targetHandleType() == Tp::HandleTypeRoom) {
+        const uint selfHandle = baseChannel->connection()->selfHandle();
+        m_groupIface = Tp::BaseChannelGroupInterface::create();
+        m_groupIface->setGroupFlags(Tp::ChannelGroupFlagProperties | Tp::ChannelGroupFlagMembersChangedDetailed);
+        m_groupIface->setSelfHandle(selfHandle);
+        baseChannel->plugInterface(Tp::AbstractChannelInterfacePtr::dynamicCast(m_groupIface));
+
+        m_members.append(selfHandle);
+        m_groupIface->setMembers(members(), QVariantMap());
+    }
 }
 
 SimpleTextChannelPtr SimpleTextChannel::create(Tp::BaseChannel *baseChannel)
@@ -52,6 +103,7 @@ SimpleTextChannelPtr SimpleTextChannel::create(Tp::BaseChannel *baseChannel)
 
 SimpleTextChannel::~SimpleTextChannel()
 {
+    SimpleCM::Metrics::adjust(SimpleCM::Metrics::PendingMessages, -m_pendingMessages.count());
 }
 
 QString SimpleTextChannel::sendMessageCallback(const Tp::MessagePartList &messageParts, uint flags, Tp::DBusError *error)
@@ -73,6 +125,11 @@ QString SimpleTextChannel::sendMessageCallback(const Tp::MessagePartList &messag
 }
 
 void SimpleTextChannel::addIncomingMessage(const QString &message)
+{
+    addIncomingMessage(message, m_targetHandle, m_targetID);
+}
+
+void SimpleTextChannel::addIncomingMessage(const QString &message, uint senderHandle, const QString &senderId)
 {
     uint timestamp = QDateTime::currentMSecsSinceEpoch() / 1000;
 
@@ -85,10 +142,148 @@ void SimpleTextChannel::addIncomingMessage(const QString &message)
     Tp::MessagePartList partList;
     Tp::MessagePart header;
     header[QLatin1String("message-received")]  = QDBusVariant(timestamp);
-    header[QLatin1String("message-sender")]    = QDBusVariant(m_targetHandle);
-    header[QLatin1String("message-sender-id")] = QDBusVariant(m_targetID);
+    header[QLatin1String("message-sender")]    = QDBusVariant(senderHandle);
+    header[QLatin1String("message-sender-id")] = QDBusVariant(senderId);
     header[QLatin1String("message-type")]      = QDBusVariant(Tp::ChannelTextMessageTypeNormal);
 
     partList << header << body;
+    addIncomingMessage(partList, senderHandle);
+}
+
+void SimpleTextChannel::addIncomingMessage(Tp::MessagePartList partList, uint senderHandle)
+{
+    if (partList.isEmpty()) {
+        return;
+    }
+
+    // The token tells which sender is released when the message is acknowledged
+    Tp::MessagePart &header = partList.first();
+    QString token = header.value(QLatin1String("message-token")).variant().toString();
+    if (token.isEmpty() || m_pendingMessages.contains(token)) {
+        token = QString::number(++m_lastMessageToken);
+        header[QLatin1String("message-token")] = QDBusVariant(token);
+    }
+
+    const qint64 bytes = messageBytes(partList);
+    m_pendingMessages.insert(token, PendingMessage { senderHandle, bytes });
+    m_pendingBytes += bytes;
+    SimpleCM::Metrics::adjust(SimpleCM::Metrics::PendingMessages, 1);
+
     addReceivedMessage(partList);
+    if (m_pendingMessages.count() == 1) {
+        emit messagesPending();
+    }
+}
+
+bool SimpleTextChannel::isRoom() const
+{
+    return !m_groupIface.isNull();
+}
+
+Tp::UIntList SimpleTextChannel::members() const
+{
+    return m_members.toList();
+}
+
+void SimpleTextChannel::addMembers(const Tp::HandleIdentifierMap &members)
+{
+    if (!m_groupIface) {
+        return;
+    }
+
+    // Both are sorted by the handle, so the merge finds the new members in one pass
+    Tp::UIntList addedHandles;
+    QStringList addedIdentifiers;
+    QVector<uint> merged;
+    merged.reserve(m_members.count() + members.count());
+    auto current = m_members.cbegin();
+    for (auto it = members.cbegin(); it != members.cend(); ++it) {
+        while ((current != m_members.cend()) && (*current < it.key())) {
+            merged.append(*current++);
+        }
+        if ((current != m_members.cend()) && (*current == it.key())) {
+            merged.append(*current++);
+            continue;
+        }
+        merged.append(it.key());
+        addedHandles.append(it.key());
+        addedIdentifiers.append(it.value());
+    }
+    if (addedHandles.isEmpty()) {
+        return;
+    }
+    while (current != m_members.cend()) {
+        merged.append(*current++);
+    }
+    m_members = merged;
+
+    // Only the delta goes to the interface, the full list would be diffed and re-inspected on every batch
+    m_groupIface->addMembers(addedHandles, addedIdentifiers);
+}
+
+void SimpleTextChannel::removeMembers(const Tp::UIntList &handles)
+{
+    if (!m_groupIface) {
+        return;
+    }
+
+    const QVector<uint> removed = sortedHandles(handles);
+    Tp::UIntList removedMembers;
+    std::set_intersection(m_members.cbegin(), m_members.cend(), removed.cbegin(), removed.cend(), std::back_inserter(removedMembers));
+    if (removedMembers.isEmpty()) {
+        return;
+    }
+    QVector<uint> members;
+    members.reserve(m_members.count() - removedMembers.count());
+    std::set_difference(m_members.cbegin(), m_members.cend(), removed.cbegin(), removed.cend(), std::back_inserter(members));
+    m_members = members;
+
+    m_groupIface->removeMembers(removedMembers);
+}
+
+QVector<uint> SimpleTextChannel::referencedHandles() const
+{
+    QVector<uint> result = m_members;
+    result.reserve(m_members.count() + m_pendingMessages.count() + 1);
+    if (!isRoom()) {
+        result.append(m_targetHandle);
+    }
+    for (const PendingMessage &message : m_pendingMessages) {
+        if (message.sender) {
+            result.append(message.sender);
+        }
+    }
+    return result;
+}
+
+int SimpleTextChannel::pendingMessageCount() const
+{
+    return m_pendingMessages.count();
+}
+
+qint64 SimpleTextChannel::channelBytes() const
+{
+    using namespace SimpleCM::MemoryUsage;
+
+    return c_baseChannelBytes + static_cast<qint64>(sizeof(SimpleTextChannel))
+            + stringBytes(m_targetID)
+            + m_members.capacity() * static_cast<qint64>(sizeof(uint))
+            + m_pendingMessages.count() * hashEntryBytes<QString, PendingMessage>();
+}
+
+qint64 SimpleTextChannel::pendingMessageBytes() const
+{
+    return m_pendingBytes;
+}
+
+void SimpleTextChannel::messageAcknowledged(QString messageToken)
+{
+    const auto it = m_pendingMessages.find(messageToken);
+    if (it == m_pendingMessages.end()) {
+        return;
+    }
+    m_pendingBytes -= it.value().bytes;
+    m_pendingMessages.erase(it);
+    SimpleCM::Metrics::adjust(SimpleCM::Metrics::PendingMessages, -1);
+    emit messagesAcknowledged();
 }
@@ -18,6 +18,9 @@
 
 #include <TelepathyQt/BaseChannel>
 
+#include <QHash>
+#include <QVector>
+
 class SimpleTextChannel;
 
 typedef Tp::SharedPtr<SimpleTextChannel> SimpleTextChannelPtr;
@@ -31,18 +34,53 @@ public:
 
     QString sendMessageCallback(const Tp::MessagePartList &messageParts, uint flags, Tp::DBusError *error);
     void addIncomingMessage(const QString &message);
+    void addIncomingMessage(const QString &message, uint senderHandle, const QString &senderId);
+    // A prepared message (e.g. from JSON), the message-token is added if missing
+    void addIncomingMessage(Tp::MessagePartList partList, uint senderHandle);
+
+    // Rooms only; every call results in a single MembersChanged signal with the delta to the members
+    bool isRoom() const;
+    Tp::UIntList members() const;
+    void addMembers(const Tp::HandleIdentifierMap &members);
+    void removeMembers(const Tp::UIntList &handles);
+
+    // The target, the members and the senders of the unacknowledged messages
+    QVector<uint> referencedHandles() const;
+    int pendingMessageCount() const;
+
+    // Approximate bytes kept by the channel objects and by the unacknowledged messages
+    qint64 channelBytes() const;
+    qint64 pendingMessageBytes() const;
 
 signals:
     void sendMessage(const QString &targetId, const QString &content);
+    // The first unacknowledged message arrived
+    void messagesPending();
+    void messagesAcknowledged();
 
 private:
     SimpleTextChannel(Tp::BaseChannel *baseChannel);
 
+    void messageAcknowledged(QString messageToken);
+
     uint m_targetHandle;
     QString m_targetID;
 
     Tp::BaseChannelTextTypePtr m_channelTextType;
     Tp::BaseChannelMessagesInterfacePtr m_messagesIface;
+    Tp::BaseChannelGroupInterfacePtr m_groupIface;
+
+    /* Sorted room member handles */
+    QVector<uint> m_members;
+    struct PendingMessage {
+        uint sender;
+        qint64 bytes;
+    };
+
+    /* Senders of the pending messages by the message token */
+    QHash<QString, PendingMessage> m_pendingMessages;
+    qint64 m_pendingBytes = 0;
+    quint64 m_lastMessageToken = 0;
 
 };
 
@@ -38,14 +38,17 @@ AccountHelper::AccountStatus AccountHelper::currentAccountStatus() const
 
 Tp::AccountPtr AccountHelper::getAccountById(const QString &identifier) const
 {
+    return m_suitableAccountsById.value(identifier);
+}
+
+QStringList AccountHelper::accountIds() const
+{
+    QStringList identifiers;
     for (const Tp::AccountPtr &suitableAccount : m_suitableAccounts) {
-        if (suitableAccount->uniqueIdentifier() != identifier) {
-            continue;
-        }
-        return suitableAccount;
+        identifiers << suitableAccount->uniqueIdentifier();
     }
 
-    return Tp::AccountPtr();
+    return identifiers;
 }
 
 void AccountHelper::start()
@@ -102,12 +105,10 @@ void AccountHelper::removeAccount(const QString &identifier)
     if (!account) {
         return;
     }
-    m_suitableAccounts.removeOne(account);
-    m_allAccounts.removeOne(account);
+    removeSuitableAccount(identifier);
+    emit accountsChanged();
 
-    Tp::PendingOperation *removeOperation = account->remove();
-    connect(removeOperation, &Tp::PendingOperation::finished,
-            this, &AccountHelper::updateSuitableAccounts);
+    account->remove();
 }
 
 void AccountHelper::connectAccount(const QString &identifier)
@@ -153,9 +154,8 @@ void AccountHelper::disconnectAccount(const QString &identifier)
         return;
     }
 
-    Tp::PendingOperation *operation = account->setEnabled(false);
-    connect(operation, &Tp::PendingOperation::finished,
-            this, &AccountHelper::updateModelData);
+    // The row follows Tp::Account::stateChanged()
+    account->setEnabled(false);
 
     if (account->isChangingPresence() || account->isOnline()) {
         requestAccountPresence(account, Tp::ConnectionPresenceTypeOffline);
@@ -190,20 +190,18 @@ void AccountHelper::setCurrentAccountStatus(AccountHelper::AccountStatus status)
 
 void AccountHelper::updateSuitableAccounts()
 {
+    for (const Tp::AccountPtr &account : m_suitableAccounts) {
+        disconnect(account.data(), nullptr, this, nullptr);
+    }
     m_suitableAccounts.clear();
-    for (const Tp::AccountPtr &account : m_allAccounts) {
-        if (account->protocolName() != m_protocolName) {
-            continue;
-        }
-        if (account->cmName() != m_managerName) {
-            continue;
-        }
-        m_suitableAccounts << account;
-        qCWarning(lcSimpleAccountHelper) << __func__
-                                         << "Suitable account:" << account->uniqueIdentifier();
+    m_suitableAccountsById.clear();
+
+    for (const Tp::AccountPtr &account : m_accountManager->allAccounts()) {
+        addSuitableAccount(account);
     }
 
     updateModelData();
+    emit accountsChanged();
 }
 
 void AccountHelper::updateModelData()
@@ -212,18 +210,87 @@ void AccountHelper::updateModelData()
         return;
     }
 
+    m_accountItems.clear();
     if (m_accountsModel->rowCount() > 0) {
         m_accountsModel->removeRows(0, m_accountsModel->rowCount());
     }
     for (const Tp::AccountPtr &account : m_suitableAccounts) {
-        QList<QStandardItem *> rowItems;
-        rowItems << new QStandardItem(account->uniqueIdentifier());
-        QString enabledText = account->isEnabled() ? tr("Enabled") : tr("Disabled");
-        rowItems << new QStandardItem(enabledText);
-        QString validText = account->isValidAccount() ? tr("Valid") : tr("Invalid");
-        rowItems << new QStandardItem(validText);
-        m_accountsModel->appendRow(rowItems);
+        appendAccountRow(account);
+    }
+}
+
+bool AccountHelper::isSuitable(const Tp::AccountPtr &account) const
+{
+    return account->protocolName() == m_protocolName && account->cmName() == m_managerName;
+}
+
+bool AccountHelper::addSuitableAccount(const Tp::AccountPtr &account)
+{
+    if (!account || !isSuitable(account)) {
+        return false;
+    }
+    const QString identifier = account->uniqueIdentifier();
+    if (m_suitableAccountsById.contains(identifier)) {
+        return false;
     }
+    qCWarning(lcSimpleAccountHelper) << __func__ << "Suitable account:" << identifier;
+
+    m_suitableAccounts << account;
+    m_suitableAccountsById.insert(identifier, account);
+
+    connect(account.data(), &Tp::Account::stateChanged,
+            this, &AccountHelper::onAccountPropertiesChanged);
+    connect(account.data(), &Tp::Account::validityChanged,
+            this, &AccountHelper::onAccountPropertiesChanged);
+    connect(account.data(), &Tp::Account::removed,
+            this, &AccountHelper::onAccountRemoved);
+    return true;
+}
+
+bool AccountHelper::removeSuitableAccount(const QString &identifier)
+{
+    const Tp::AccountPtr account = m_suitableAccountsById.take(identifier);
+    if (!account) {
+        return false;
+    }
+    m_suitableAccounts.removeOne(account);
+    disconnect(account.data(), nullptr, this, nullptr);
+
+    QStandardItem *item = m_accountItems.take(identifier);
+    if (m_accountsModel && item) {
+        m_accountsModel->removeRow(item->row());
+    }
+    return true;
+}
+
+void AccountHelper::appendAccountRow(const Tp::AccountPtr &account)
+{
+    if (!m_accountsModel) {
+        return;
+    }
+
+    QList<QStandardItem *> rowItems;
+    rowItems << new QStandardItem(account->uniqueIdentifier());
+    rowItems << new QStandardItem();
+    rowItems << new QStandardItem();
+    m_accountItems.insert(account->uniqueIdentifier(), rowItems.constFirst());
+    m_accountsModel->appendRow(rowItems);
+    updateAccountRow(account);
+}
+
+void AccountHelper::updateAccountRow(const Tp::AccountPtr &account)
+{
+    const QStandardItem *item = m_accountItems.value(account->uniqueIdentifier());
+    if (!m_accountsModel || !item) {
+        return;
+    }
+
+    // QStandardItem::setText() emits dataChanged() for the cell only if the text differs
+    const int row = item->row();
+    QString enabledText = account->isEnabled() ? tr("Enabled") : tr("Disabled");
+    m_accountsModel->item(row, AccountModelSection::AccountEnabled)->setText(enabledText);
+    QString validText = account->isValidAccount() ? tr("Valid") : tr("Invalid");
+    m_accountsModel->item(row, AccountModelSection::AccountValid)->setText(validText);
 }
 
 void AccountHelper::requestAccountOnline()
@@ -276,13 +343,15 @@ void AccountHelper::onAccountManagerReady(Tp::PendingOperation *operation)
     }
 
     qCDebug(lcSimpleAccountHelper) << "Account manager is ready.";
-    m_allAccounts = m_accountManager->allAccounts();
     updateSuitableAccounts();
 }
 
 void AccountHelper::onNewAccount(const Tp::AccountPtr &account)
 {
-    updateSuitableAccounts();
+    if (addSuitableAccount(account)) {
+        appendAccountRow(account);
+        emit accountsChanged();
+    }
 }
 
 void AccountHelper::onAccountCreated(Tp::PendingOperation *operation)
@@ -291,8 +360,9 @@ void AccountHelper::onAccountCreated(Tp::PendingOperation *operation)
         qCWarning(lcSimpleAccountHelper) << operation->errorName() << operation->errorMessage();
         return;
     }
-    m_allAccounts = m_accountManager->allAccounts();
-    updateSuitableAccounts();
+    // Usually AccountManager::newAccount() has already added it
+    Tp::PendingAccount *pendingAccount = static_cast<Tp::PendingAccount *>(operation);
+    onNewAccount(pendingAccount->account());
 }
 
 void AccountHelper::reValidateAccount()
@@ -317,7 +387,7 @@ void AccountHelper::onAccountValid()
         disconnectAccount(currentAccountId());
         return;
     }
-    updateSuitableAccounts();
+    updateAccountRow(m_currentAccount);
 
     if (!m_currentAccount->isEnabled()) {
         enableAccount();
@@ -365,6 +435,29 @@ void AccountHelper::onAccountStateChanged()
 void AccountHelper::onAccountEnabled()
 {
     qCDebug(lcSimpleAccountHelper) << __func__;
-    updateModelData();
+    updateAccountRow(m_currentAccount);
     requestAccountOnline();
 }
+
+void AccountHelper::onAccountPropertiesChanged()
+{
+    const Tp::Account *account = qobject_cast<Tp::Account *>(sender());
+    if (!account) {
+        return;
+    }
+    const Tp::AccountPtr suitableAccount = getAccountById(account->uniqueIdentifier());
+    if (suitableAccount) {
+        updateAccountRow(suitableAccount);
+    }
+}
+
+void AccountHelper::onAccountRemoved()
+{
+    const Tp::Account *account = qobject_cast<Tp::Account *>(sender());
+    if (!account) {
+        return;
+    }
+    if (removeSuitableAccount(account->uniqueIdentifier())) {
+        emit accountsChanged();
+    }
+}
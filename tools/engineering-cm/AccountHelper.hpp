@@ -7,8 +7,11 @@
 #include <TelepathyQt/ServiceTypes>
 #include <TelepathyQt/Types>
 
+#include <QHash>
+
 QT_FORWARD_DECLARE_CLASS(QAbstractItemModel)
 QT_FORWARD_DECLARE_CLASS(QModelIndex)
+QT_FORWARD_DECLARE_CLASS(QStandardItem)
 QT_FORWARD_DECLARE_CLASS(QStandardItemModel)
 
 class AccountHelper : public QObject
@@ -39,6 +42,7 @@ public:
     AccountStatus currentAccountStatus() const;
 
     Tp::AccountPtr getAccountById(const QString &identifier) const;
+    QStringList accountIds() const;
 
 public slots:
     void start();
@@ -55,6 +59,8 @@ public slots:
 signals:
     void currentAccountIdChanged();
     void currentAccountStatusChanged();
+    // A suitable account is added or removed, or the accounts are (re)loaded
+    void accountsChanged();
 
 protected slots:
     void onAccountManagerReady(Tp::PendingOperation *operation);
@@ -64,6 +70,8 @@ protected slots:
     void onAccountSetEnableFinished(Tp::PendingOperation *operation = nullptr);
     void onAccountStateChanged();
     void onAccountEnabled();
+    void onAccountPropertiesChanged();
+    void onAccountRemoved();
 
 protected:
     void initAccountManager();
@@ -72,6 +80,12 @@ protected:
     void updateSuitableAccounts();
     void updateModelData();
 
+    bool isSuitable(const Tp::AccountPtr &account) const;
+    bool addSuitableAccount(const Tp::AccountPtr &account);
+    bool removeSuitableAccount(const QString &identifier);
+    void appendAccountRow(const Tp::AccountPtr &account);
+    void updateAccountRow(const Tp::AccountPtr &account);
+
     void reValidateAccount();
     void enableAccount();
     void requestAccountOnline();
@@ -79,8 +93,10 @@ protected:
 
 protected:
     Tp::AccountManagerPtr m_accountManager;
-    QList<Tp::AccountPtr> m_allAccounts;
     QList<Tp::AccountPtr> m_suitableAccounts;
+    QHash<QString, Tp::AccountPtr> m_suitableAccountsById;
+    // The AccountId column items of the model rows
+    QHash<QString, QStandardItem *> m_accountItems;
     Tp::AccountPtr m_currentAccount;
     AccountStatus m_accountStatus = AccountStatus::NoAccount;
     QString m_managerName;
@@ -0,0 +1,311 @@
+#include "AccountProvisioner.hpp"
+
+#include <TelepathyQt/Account>
+#include <TelepathyQt/PendingAccount>
+#include <TelepathyQt/PendingComposite>
+
+#include <QLoggingCategory>
+#include <QTimer>
+
+Q_LOGGING_CATEGORY(lcSimpleAccountProvisioner, "simple.accountProvisioner", QtWarningMsg)
+
+AccountProvisioner::AccountProvisioner(QObject *parent)
+    : QObject(parent),
+      m_selfIdPattern(QStringLiteral("provisioned_%1"))
+{
+}
+
+void AccountProvisioner::setManagerName(const QString &name)
+{
+    m_managerName = name;
+}
+
+void AccountProvisioner::setProtocolName(const QString &name)
+{
+    m_protocolName = name;
+}
+
+void AccountProvisioner::setSelfIdPattern(const QString &pattern)
+{
+    m_selfIdPattern = pattern;
+}
+
+void AccountProvisioner::setConcurrency(int concurrency)
+{
+    m_concurrency = qMax(1, concurrency);
+}
+
+void AccountProvisioner::setTimeout(int msecs)
+{
+    m_timeout = msecs;
+}
+
+QVector<ProvisionedAccount> AccountProvisioner::accounts() const
+{
+    return m_accounts;
+}
+
+int AccountProvisioner::onlineCount() const
+{
+    int count = 0;
+    for (const ProvisionedAccount &account : m_accounts) {
+        if (account.onlineAt) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+int AccountProvisioner::failedCount() const
+{
+    int count = 0;
+    for (const ProvisionedAccount &account : m_accounts) {
+        if (!account.error.isEmpty()) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+qint64 AccountProvisioner::elapsed() const
+{
+    return m_finishedAt;
+}
+
+void AccountProvisioner::provision(int count)
+{
+    if (m_inFlight > 0) {
+        qCWarning(lcSimpleAccountProvisioner) << __func__ << "The provisioning is already running";
+        return;
+    }
+
+    m_accounts = QVector<ProvisionedAccount>(qMax(0, count));
+    m_accountPtrs = QVector<Tp::AccountPtr>(m_accounts.count());
+    for (int i = 0; i < m_accounts.count(); ++i) {
+        m_accounts[i].selfId = m_selfIdPattern.arg(i + 1);
+    }
+    ++m_run;
+    m_next = 0;
+    m_finished = 0;
+    m_finishedAt = 0;
+    m_clock.start();
+
+    if (!m_accountManager) {
+        const Tp::Features accountFeatures = Tp::Account::FeatureCore;
+        Tp::AccountFactoryPtr accountFactory = Tp::AccountFactory::create(QDBusConnection::sessionBus(),
+                                                                          accountFeatures);
+        m_accountManager = Tp::AccountManager::create(accountFactory);
+        connect(m_accountManager->becomeReady(), &Tp::PendingOperation::finished,
+                this, &AccountProvisioner::onAccountManagerReady);
+        return;
+    }
+
+    if (m_accountManager->isReady()) {
+        startNext();
+    }
+}
+
+void AccountProvisioner::removeAccounts()
+{
+    QList<Tp::PendingOperation *> operations;
+    for (const Tp::AccountPtr &account : m_accountPtrs) {
+        if (account) {
+            account->disconnect(this);
+            operations << account->remove();
+        }
+    }
+    m_accountPtrs = QVector<Tp::AccountPtr>(m_accountPtrs.count());
+
+    if (operations.isEmpty()) {
+        QTimer::singleShot(0, this, &AccountProvisioner::accountsRemoved);
+        return;
+    }
+    Tp::PendingComposite *composite = new Tp::PendingComposite(operations, m_accountManager);
+    connect(composite, &Tp::PendingOperation::finished, this, &AccountProvisioner::accountsRemoved);
+}
+
+void AccountProvisioner::onAccountManagerReady(Tp::PendingOperation *operation)
+{
+    if (operation->isError()) {
+        qCCritical(lcSimpleAccountProvisioner) << "Unable to init account manager:"
+                                               << operation->errorName() << operation->errorMessage();
+        for (int i = 0; i < m_accounts.count(); ++i) {
+            m_accounts[i].error = operation->errorName();
+        }
+        m_finished = m_accounts.count();
+        emit finished();
+        return;
+    }
+
+    startNext();
+}
+
+void AccountProvisioner::startNext()
+{
+    while ((m_inFlight < m_concurrency) && (m_next < m_accounts.count())) {
+        const int index = m_next++;
+        ++m_inFlight;
+        m_accounts[index].startedAt = now();
+        createAccount(index);
+    }
+
+    if (m_finished == m_accounts.count()) {
+        m_finishedAt = now();
+        emit finished();
+    }
+}
+
+void AccountProvisioner::createAccount(int index)
+{
+    const QString selfId = m_accounts.at(index).selfId;
+    const QVariantMap parameters = {
+        { QStringLiteral("self_id"), selfId },
+    };
+    const QVariantMap properties = {
+        { TP_QT_IFACE_ACCOUNT + QLatin1String(".Enabled"), false },
+    };
+
+    const int run = m_run;
+    Tp::PendingAccount *pendingAccount = m_accountManager->createAccount(m_managerName, m_protocolName,
+                                                                         selfId, parameters, properties);
+    connect(pendingAccount, &Tp::PendingOperation::finished, this, [this, run, index, pendingAccount]() {
+        if (run != m_run) {
+            return;
+        }
+        if (pendingAccount->isError()) {
+            setFailed(index, pendingAccount);
+            return;
+        }
+        // Kept even if the account has timed out meanwhile, to be removed with the others
+        m_accountPtrs[index] = pendingAccount->account();
+        m_accounts[index].identifier = pendingAccount->account()->uniqueIdentifier();
+        if (!isActive(run, index)) {
+            return;
+        }
+        m_accounts[index].createdAt = now();
+        validateAccount(index);
+    });
+
+    QTimer::singleShot(m_timeout, this, [this, run, index]() {
+        if (isActive(run, index)) {
+            setFailed(index, QStringLiteral("Timeout"));
+        }
+    });
+}
+
+void AccountProvisioner::validateAccount(int index)
+{
+    const int run = m_run;
+    const Tp::AccountPtr account = m_accountPtrs.at(index);
+    if (account->isValidAccount()) {
+        enableAccount(index);
+        return;
+    }
+
+    // Update an account parameter to trigger re-validation
+    Tp::PendingOperation *operation = account->updateParameters(account->parameters(), { });
+    connect(operation, &Tp::PendingOperation::finished, this, [this, run, index, account](Tp::PendingOperation *operation) {
+        if (!isActive(run, index)) {
+            return;
+        }
+        if (operation->isError()) {
+            setFailed(index, operation);
+            return;
+        }
+        if (!account->isValidAccount()) {
+            setFailed(index, QStringLiteral("The account is invalid"));
+            return;
+        }
+        enableAccount(index);
+    });
+}
+
+void AccountProvisioner::enableAccount(int index)
+{
+    const int run = m_run;
+    Tp::PendingOperation *operation = m_accountPtrs.at(index)->setEnabled(true);
+    connect(operation, &Tp::PendingOperation::finished, this, [this, run, index](Tp::PendingOperation *operation) {
+        if (!isActive(run, index)) {
+            return;
+        }
+        if (operation->isError()) {
+            setFailed(index, operation);
+            return;
+        }
+        m_accounts[index].enabledAt = now();
+        requestOnline(index);
+    });
+}
+
+void AccountProvisioner::requestOnline(int index)
+{
+    const int run = m_run;
+    const Tp::AccountPtr account = m_accountPtrs.at(index);
+    connect(account.data(), &Tp::Account::connectionStatusChanged, this, [this, index](Tp::ConnectionStatus status) {
+        if (status == Tp::ConnectionStatusConnected) {
+            setOnline(index);
+        } else if ((status == Tp::ConnectionStatusDisconnected) && !m_accountPtrs.at(index)->connectionError().isEmpty()) {
+            setFailed(index, m_accountPtrs.at(index)->connectionError());
+        }
+    });
+
+    Tp::PendingOperation *operation = account->setRequestedPresence(Tp::Presence::available());
+    connect(operation, &Tp::PendingOperation::finished, this, [this, run, index](Tp::PendingOperation *operation) {
+        if (isActive(run, index) && operation->isError()) {
+            setFailed(index, operation);
+        }
+    });
+
+    if (account->connectionStatus() == Tp::ConnectionStatusConnected) {
+        setOnline(index);
+    }
+}
+
+void AccountProvisioner::setOnline(int index)
+{
+    ProvisionedAccount &account = m_accounts[index];
+    if (account.isFinished()) {
+        return;
+    }
+    account.onlineAt = now();
+    m_accountPtrs.at(index)->disconnect(this);
+
+    --m_inFlight;
+    ++m_finished;
+    emit accountOnline(index);
+    startNext();
+}
+
+void AccountProvisioner::setFailed(int index, const QString &error)
+{
+    ProvisionedAccount &account = m_accounts[index];
+    if (account.isFinished()) {
+        return;
+    }
+    account.error = error;
+    if (m_accountPtrs.at(index)) {
+        m_accountPtrs.at(index)->disconnect(this);
+    }
+    qCWarning(lcSimpleAccountProvisioner) << __func__ << account.selfId << error;
+
+    --m_inFlight;
+    ++m_finished;
+    emit accountFailed(index, error);
+    startNext();
+}
+
+void AccountProvisioner::setFailed(int index, Tp::PendingOperation *operation)
+{
+    setFailed(index, operation->errorName() + QLatin1String(": ") + operation->errorMessage());
+}
+
+bool AccountProvisioner::isActive(int run, int index) const
+{
+    // The operations of a previous run and of the timed out accounts may still finish
+    return (run == m_run) && !m_accounts.at(index).isFinished();
+}
+
+qint64 AccountProvisioner::now() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
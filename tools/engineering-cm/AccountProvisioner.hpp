@@ -0,0 +1,89 @@
+#ifndef SIMPLE_ACCOUNT_PROVISIONER_HPP
+#define SIMPLE_ACCOUNT_PROVISIONER_HPP
+
+#include <TelepathyQt/AccountManager>
+#include <TelepathyQt/PendingOperation>
+#include <TelepathyQt/Types>
+
+#include <QElapsedTimer>
+#include <QVector>
+
+struct ProvisionedAccount
+{
+    QString selfId;
+    QString identifier;
+    QString error;
+
+    // Microseconds since the provisioning start, 0 until reached
+    qint64 startedAt = 0;
+    qint64 createdAt = 0;
+    qint64 enabledAt = 0;
+    qint64 onlineAt = 0;
+
+    bool isFinished() const { return onlineAt || !error.isEmpty(); }
+    qint64 timeToOnline() const { return onlineAt ? onlineAt - startedAt : 0; }
+};
+
+/* Creates, enables and brings online a number of accounts, running up to the concurrency limit of them at once */
+class AccountProvisioner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit AccountProvisioner(QObject *parent = nullptr);
+
+    void setManagerName(const QString &name);
+    void setProtocolName(const QString &name);
+    // "%1" is replaced by the account number
+    void setSelfIdPattern(const QString &pattern);
+    void setConcurrency(int concurrency);
+    void setTimeout(int msecs);
+
+    QVector<ProvisionedAccount> accounts() const;
+    int onlineCount() const;
+    int failedCount() const;
+    // Microseconds from the start to the last finished account
+    qint64 elapsed() const;
+
+public slots:
+    void provision(int count);
+    void removeAccounts();
+
+signals:
+    void accountOnline(int index);
+    void accountFailed(int index, const QString &error);
+    void finished();
+    void accountsRemoved();
+
+protected slots:
+    void onAccountManagerReady(Tp::PendingOperation *operation);
+
+protected:
+    void startNext();
+    void createAccount(int index);
+    void validateAccount(int index);
+    void enableAccount(int index);
+    void requestOnline(int index);
+    void setOnline(int index);
+    void setFailed(int index, const QString &error);
+    void setFailed(int index, Tp::PendingOperation *operation);
+    bool isActive(int run, int index) const;
+    qint64 now() const;
+
+    Tp::AccountManagerPtr m_accountManager;
+    QString m_managerName;
+    QString m_protocolName;
+    QString m_selfIdPattern;
+    int m_concurrency = 8;
+    int m_timeout = 30000;
+
+    QVector<ProvisionedAccount> m_accounts;
+    QVector<Tp::AccountPtr> m_accountPtrs;
+    int m_run = 0;
+    int m_next = 0;
+    int m_inFlight = 0;
+    int m_finished = 0;
+    qint64 m_finishedAt = 0;
+    QElapsedTimer m_clock;
+};
+
+#endif // SIMPLE_ACCOUNT_PROVISIONER_HPP
@@ -1,16 +1,36 @@
 #include "CContactsModel.hpp"
 
+#include <SimpleCM/ContactNormalizer>
 #include <SimpleCM/Service>
 
+#include <algorithm>
+
+// The presence changes are announced to the views at most once per frame
+static const int c_presenceFlushInterval = 16;
+
 CContactsModel::CContactsModel(QObject *parent) :
     QAbstractTableModel(parent),
     m_service(0)
 {
+    m_presenceFlushTimer.setSingleShot(true);
+    m_presenceFlushTimer.setInterval(c_presenceFlushInterval);
+    connect(&m_presenceFlushTimer, &QTimer::timeout, this, &CContactsModel::flushPresenceChanges);
 }
 
 void CContactsModel::setService(SimpleCM::Service *service)
 {
+    if (m_service) {
+        disconnect(m_service, nullptr, this, nullptr);
+    }
     m_service = service;
+    m_resolveRequests.clear();
+    rebuildRows();
+    if (m_service) {
+        connect(m_service, &SimpleCM::Service::contactsResolved,
+                this, &CContactsModel::onContactsResolved);
+        connect(m_service, &SimpleCM::Service::contactPresencesChanged,
+                this, &CContactsModel::onContactPresencesChanged);
+    }
 }
 
 QVector<CContactsModel::Column> CContactsModel::columns() const
@@ -45,7 +65,7 @@ QVariant CContactsModel::data(const QModelIndex &index, int role) const
 
     int contactIndex = index.row();
 
-    if ((contactIndex < 0) || (contactIndex > rowCount())) {
+    if ((contactIndex < 0) || (contactIndex >= rowCount())) {
         return QVariant();
     }
 
@@ -113,7 +133,7 @@ bool CContactsModel::setData(const QModelIndex &index, const QVariant &value, in
 
     int contactIndex = index.row();
 
-    if ((contactIndex < 0) || (contactIndex > rowCount())) {
+    if ((contactIndex < 0) || (contactIndex >= rowCount())) {
         return false;
     }
 
@@ -127,8 +147,8 @@ bool CContactsModel::setData(const QModelIndex &index, const QVariant &value, in
             return false;
         }
 
-        m_contacts[contactIndex].presence = value.toString();
-        m_service->setContactPresence(m_contacts.at(contactIndex).identifier, m_contacts.at(contactIndex).presence);
+        // The view is updated from the service notification
+        m_service->setContactPresence(m_contacts.at(contactIndex).identifier, strValue);
         return true;
     default:
         return false;
@@ -137,13 +157,60 @@ bool CContactsModel::setData(const QModelIndex &index, const QVariant &value, in
 
 void CContactsModel::ensureContact(const QString &identifier)
 {
-    for (int i = 0; i < m_contacts.count(); ++i) {
-        if (m_contacts.at(i).identifier == identifier) {
-            return;
+    if (rowOf(identifier) >= 0) {
+        return;
+    }
+
+    addContacts(QStringList() << identifier);
+}
+
+void CContactsModel::addContacts(const QStringList &identifiers)
+{
+    QStringList newIdentifiers;
+    newIdentifiers.reserve(identifiers.count());
+    const int firstRow = m_contacts.count();
+    int row = firstRow;
+    m_rows.reserve(m_rows.count() + identifiers.count());
+    for (const QString &identifier : identifiers) {
+        if (identifier.isEmpty()) {
+            continue;
         }
+        const QString key = contactKey(identifier);
+        if (m_rows.contains(key)) {
+            continue;
+        }
+        m_rows.insert(key, row++);
+        newIdentifiers.append(identifier);
+    }
+    if (newIdentifiers.isEmpty()) {
+        return;
     }
 
-    addContact(identifier);
+    beginInsertRows(QModelIndex(), firstRow, firstRow + newIdentifiers.count() - 1);
+    m_contacts.reserve(m_contacts.count() + newIdentifiers.count());
+    const QString presence = QStringLiteral("unknown");
+    for (const QString &identifier : newIdentifiers) {
+        SContact contact;
+        contact.identifier = identifier;
+        contact.presence = presence;
+        m_contacts.append(contact);
+    }
+    endInsertRows();
+
+    // The handles are filled in by onContactsResolved()
+    if (m_service) {
+        m_resolveRequests.insert(m_service->resolveContacts(newIdentifiers));
+    }
+}
+
+int CContactsModel::rowOf(const QString &identifier) const
+{
+    return m_rows.value(contactKey(identifier), -1);
+}
+
+bool CContactsModel::hasPendingResolves() const
+{
+    return !m_resolveRequests.isEmpty();
 }
 
 Qt::ItemFlags CContactsModel::flags(const QModelIndex &index) const
@@ -161,19 +228,110 @@ Qt::ItemFlags CContactsModel::flags(const QModelIndex &index) const
     return Qt::NoItemFlags;
 }
 
-int CContactsModel::addContact(const QString identifier)
+void CContactsModel::onContactPresencesChanged(const QString &account, const QStringList &identifiers, const QString &presence)
 {
-    SContact contact;
-    contact.identifier = identifier;
-    contact.presence = "unknown";
-    contact.handle = m_service->addContact(contact.identifier);
+    if (!account.isEmpty() && (account != m_service->selfContactIdentifier())) {
+        return;
+    }
 
-    int newContactIndex = m_contacts.count();
-    beginInsertRows(QModelIndex(), newContactIndex, newContactIndex);
-    m_contacts.append(contact);
-    endInsertRows();
+    for (const QString &identifier : identifiers) {
+        const int row = rowOf(identifier);
+        if ((row < 0) || (m_contacts.at(row).presence == presence)) {
+            continue;
+        }
+        m_contacts[row].presence = presence;
+        m_changedPresenceContacts.insert(contactKey(identifier));
+    }
 
-    return newContactIndex;
+    if (!m_changedPresenceContacts.isEmpty() && !m_presenceFlushTimer.isActive()) {
+        m_presenceFlushTimer.start();
+    }
+}
+
+void CContactsModel::flushPresenceChanges()
+{
+    const int presenceColumn = m_columns.indexOf(Column::Presence);
+    if ((presenceColumn < 0) || m_changedPresenceContacts.isEmpty()) {
+        m_changedPresenceContacts.clear();
+        return;
+    }
+
+    // The rows are looked up only now, the contacts can be moved since the change
+    QVector<int> rows;
+    rows.reserve(m_changedPresenceContacts.count());
+    for (const QString &key : m_changedPresenceContacts) {
+        const int row = m_rows.value(key, -1);
+        if (row >= 0) {
+            rows.append(row);
+        }
+    }
+    m_changedPresenceContacts.clear();
+    if (rows.isEmpty()) {
+        return;
+    }
+    std::sort(rows.begin(), rows.end());
+
+    // One signal per contiguous range of the changed rows
+    int first = rows.constFirst();
+    int last = first;
+    for (int i = 1; i < rows.count(); ++i) {
+        const int row = rows.at(i);
+        if (row == last + 1) {
+            last = row;
+            continue;
+        }
+        emit dataChanged(index(first, presenceColumn), index(last, presenceColumn));
+        first = row;
+        last = row;
+    }
+    emit dataChanged(index(first, presenceColumn), index(last, presenceColumn));
+}
+
+void CContactsModel::onContactsResolved(quint32 requestId, const QString &account,
+                                        const QStringList &identifiers, const QList<quint32> &handles)
+{
+    Q_UNUSED(account)
+    if (!m_resolveRequests.remove(requestId)) {
+        return;
+    }
+
+    int firstRow = -1;
+    int lastRow = -1;
+    const int count = qMin(identifiers.count(), handles.count());
+    for (int i = 0; i < count; ++i) {
+        const int row = rowOf(identifiers.at(i));
+        if (row < 0) {
+            continue;
+        }
+        m_contacts[row].handle = handles.at(i);
+        firstRow = (firstRow < 0) ? row : qMin(firstRow, row);
+        lastRow = qMax(lastRow, row);
+    }
+
+    const int handleColumn = m_columns.indexOf(Column::Handle);
+    if ((firstRow < 0) || (handleColumn < 0)) {
+        return;
+    }
+    emit dataChanged(index(firstRow, handleColumn), index(lastRow, handleColumn));
+}
+
+QString CContactsModel::contactKey(const QString &identifier) const
+{
+    if (!m_service || !m_service->contactNormalizer()) {
+        return identifier;
+    }
+    // The invalid identifiers are used as is, like the connection does
+    const QString normalized = m_service->contactNormalizer()->normalize(identifier);
+    return normalized.isEmpty() ? identifier : normalized;
+}
+
+void CContactsModel::rebuildRows()
+{
+    m_rows.clear();
+    m_rows.reserve(m_contacts.count());
+    for (int row = 0; row < m_contacts.count(); ++row) {
+        m_rows.insert(contactKey(m_contacts.at(row).identifier), row);
+    }
 }
 
 CContactsModel::Column CContactsModel::intToColumn(int columnIndex) const
@@ -2,7 +2,10 @@
 #define CONTACTLISTMODEL_H
 
 #include <QAbstractTableModel>
+#include <QHash>
 #include <QList>
+#include <QSet>
+#include <QTimer>
 
 struct SContact {
     QString identifier;
@@ -42,6 +45,12 @@ public:
     bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
 
     void ensureContact(const QString &identifier);
+    // Appends the unknown identifiers as one row range and resolves their handles in one service call
+    void addContacts(const QStringList &identifiers);
+
+    int rowOf(const QString &identifier) const;
+    // Some added contacts wait for their handles
+    bool hasPendingResolves() const;
 
     Qt::ItemFlags flags(const QModelIndex &index) const;
 
@@ -49,13 +58,27 @@ signals:
 
 public slots:
 
+private slots:
+    void onContactPresencesChanged(const QString &account, const QStringList &identifiers, const QString &presence);
+    void flushPresenceChanges();
+    void onContactsResolved(quint32 requestId, const QString &account,
+                            const QStringList &identifiers, const QList<quint32> &handles);
+
 private:
-    int addContact(const QString identifier);
     Column intToColumn(int column) const;
+    // The connections report the contacts by their normalized identifiers
+    QString contactKey(const QString &identifier) const;
+    void rebuildRows();
 
     SimpleCM::Service *m_service = nullptr;
     QVector<Column> m_columns;
     QVector<SContact> m_contacts;
+    /* Row of the contact by its normalized identifier */
+    QHash<QString, int> m_rows;
+    QSet<quint32> m_resolveRequests;
+    /* Normalized identifiers of the contacts with a presence change not announced to the views yet */
+    QSet<QString> m_changedPresenceContacts;
+    QTimer m_presenceFlushTimer;
 
 };
 
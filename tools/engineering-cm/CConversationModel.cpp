@@ -0,0 +1,42 @@
+#include "CConversationModel.hpp"
+
+#include "CMessagesLogModel.hpp"
+
+CConversationModel::CConversationModel(QObject *parent) :
+    QSortFilterProxyModel(parent)
+{
+}
+
+QString CConversationModel::chat() const
+{
+    return m_chat;
+}
+
+void CConversationModel::setChat(const QString &chat)
+{
+    if (m_chat == chat) {
+        return;
+    }
+    m_chat = chat;
+    invalidateFilter();
+}
+
+QVariant CConversationModel::data(const QModelIndex &index, int role) const
+{
+    if (role != Qt::DisplayRole) {
+        return QSortFilterProxyModel::data(index, role);
+    }
+
+    const bool incoming = QSortFilterProxyModel::data(index, CMessagesLogModel::IncomingRole).toBool();
+    const QString text = QSortFilterProxyModel::data(index, CMessagesLogModel::TextRole).toString();
+    return (incoming ? QStringLiteral("< ") : QStringLiteral("> ")) + text;
+}
+
+bool CConversationModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    if (m_chat.isEmpty()) {
+        return false;
+    }
+    const QModelIndex index = sourceModel()->index(sourceRow, 0, sourceParent);
+    return index.data(CMessagesLogModel::ChatRole).toString() == m_chat;
+}
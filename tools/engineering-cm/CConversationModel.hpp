@@ -0,0 +1,27 @@
+#ifndef CONVERSATIONMODEL_H
+#define CONVERSATIONMODEL_H
+
+#include <QSortFilterProxyModel>
+
+/* The messages of a single chat of a CMessagesLogModel, shown as "< incoming" and "> outgoing" */
+class CConversationModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+public:
+    explicit CConversationModel(QObject *parent = nullptr);
+
+    QString chat() const;
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+public slots:
+    void setChat(const QString &chat);
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    QString m_chat;
+};
+
+#endif // CONVERSATIONMODEL_H
@@ -0,0 +1,131 @@
+#include "CMessagesLogModel.hpp"
+
+static const int c_defaultCapacity = 10000;
+// The appended rows are inserted at most this often
+static const int c_flushInterval = 50;
+
+CMessagesLogModel::CMessagesLogModel(QObject *parent) :
+    QAbstractListModel(parent),
+    m_entries(c_defaultCapacity)
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(c_flushInterval);
+    connect(&m_flushTimer, &QTimer::timeout, this, &CMessagesLogModel::flush);
+}
+
+int CMessagesLogModel::capacity() const
+{
+    return m_entries.count();
+}
+
+void CMessagesLogModel::setCapacity(int capacity)
+{
+    beginResetModel();
+    m_entries = QVector<SLogEntry>(qMax(1, capacity));
+    m_first = 0;
+    m_count = 0;
+    m_pending.clear();
+    endResetModel();
+}
+
+int CMessagesLogModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return m_count;
+}
+
+QVariant CMessagesLogModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || (index.row() >= m_count)) {
+        return QVariant();
+    }
+
+    const SLogEntry &entry = entryAt(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return tr("[%1] %2: %3").arg(entry.chat, entry.from, entry.text);
+    case ChatRole:
+        return entry.chat;
+    case FromRole:
+        return entry.from;
+    case TextRole:
+        return entry.text;
+    case IncomingRole:
+        return entry.incoming;
+    default:
+        break;
+    }
+
+    return QVariant();
+}
+
+QHash<int, QByteArray> CMessagesLogModel::roleNames() const
+{
+    QHash<int, QByteArray> roles = QAbstractListModel::roleNames();
+    roles.insert(ChatRole, "chat");
+    roles.insert(FromRole, "from");
+    roles.insert(TextRole, "text");
+    roles.insert(IncomingRole, "incoming");
+    return roles;
+}
+
+void CMessagesLogModel::appendMessage(const QString &chat, const QString &from, const QString &text, bool incoming)
+{
+    SLogEntry entry;
+    entry.chat = chat;
+    entry.from = from;
+    entry.text = text;
+    entry.incoming = incoming;
+    m_pending.append(entry);
+
+    if (m_pending.count() >= capacity()) {
+        flush();
+        return;
+    }
+    if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+}
+
+void CMessagesLogModel::clear()
+{
+    setCapacity(capacity());
+}
+
+void CMessagesLogModel::flush()
+{
+    m_flushTimer.stop();
+    if (m_pending.isEmpty()) {
+        return;
+    }
+
+    const int capacity = m_entries.count();
+    if (m_pending.count() > capacity) {
+        m_pending.erase(m_pending.begin(), m_pending.end() - capacity);
+    }
+
+    // The oldest rows give their slots to the new ones
+    const int overflow = m_count + m_pending.count() - capacity;
+    if (overflow > 0) {
+        beginRemoveRows(QModelIndex(), 0, overflow - 1);
+        m_first = (m_first + overflow) % capacity;
+        m_count -= overflow;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), m_count, m_count + m_pending.count() - 1);
+    for (const SLogEntry &entry : m_pending) {
+        m_entries[(m_first + m_count) % capacity] = entry;
+        ++m_count;
+    }
+    endInsertRows();
+
+    m_pending.clear();
+}
+
+const SLogEntry &CMessagesLogModel::entryAt(int row) const
+{
+    return m_entries.at((m_first + row) % m_entries.count());
+}
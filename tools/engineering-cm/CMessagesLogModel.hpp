@@ -0,0 +1,57 @@
+#ifndef MESSAGESLOGMODEL_H
+#define MESSAGESLOGMODEL_H
+
+#include <QAbstractListModel>
+#include <QTimer>
+#include <QVector>
+
+struct SLogEntry {
+    QString chat;
+    QString from;
+    QString text;
+    bool incoming = true;
+};
+
+/* The latest messages (up to the capacity); the appends are announced to the views in batches */
+class CMessagesLogModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum Role {
+        ChatRole = Qt::UserRole + 1,
+        FromRole,
+        TextRole,
+        IncomingRole,
+    };
+
+    explicit CMessagesLogModel(QObject *parent = nullptr);
+
+    int capacity() const;
+    // Drops the logged messages
+    void setCapacity(int capacity);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+public slots:
+    void appendMessage(const QString &chat, const QString &from, const QString &text, bool incoming);
+    void clear();
+
+private slots:
+    void flush();
+
+private:
+    const SLogEntry &entryAt(int row) const;
+
+    /* Ring storage of capacity entries, the rows start at m_first */
+    QVector<SLogEntry> m_entries;
+    int m_first = 0;
+    int m_count = 0;
+
+    /* Appended but not yet announced */
+    QVector<SLogEntry> m_pending;
+    QTimer m_flushTimer;
+};
+
+#endif // MESSAGESLOGMODEL_H
@@ -3,20 +3,35 @@
 
 #include "CContactsModel.hpp"
 #include "CComboBoxDelegate.hpp"
+#include "CConversationModel.hpp"
+#include "CMessagesLogModel.hpp"
 #include "PresetsLoader.hpp"
+#include "RosterImporter.hpp"
+#include "ServicePreset.hpp"
 
 #ifndef SIMPLECM_ENABLE_LOWLEVEL_API
 #define SIMPLECM_ENABLE_LOWLEVEL_API
 #endif
 
-#include <TelepathyQt/BaseProtocol>
-
 #include <SimpleCM/Chat>
 #include <SimpleCM/Message>
 #include <SimpleCM/Service>
 #include <SimpleCM/ServiceLowLevel>
+#include <SimpleCM/TrafficRecorder>
 
 #include <QCompleter>
+#include <QFileDialog>
+#include <QHeaderView>
+#include <QRegularExpression>
+#include <QScrollBar>
+#include <QSharedPointer>
+#include <QSortFilterProxyModel>
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+static const Qt::SplitBehavior c_skipEmptyParts = Qt::SkipEmptyParts;
+#else
+static const QString::SplitBehavior c_skipEmptyParts = QString::SkipEmptyParts;
+#endif
 
 QString MainWindow::accountStatusToString(AccountHelper::AccountStatus status)
 {
@@ -57,14 +72,43 @@ MainWindow::MainWindow(QWidget *parent) :
     m_contactsModel->setService(m_service);
 
     ui->contactsView->setModel(m_contactsModel);
+    // Fixed row heights keep the view responsive with very large rosters
+    ui->contactsView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    ui->contactsView->verticalHeader()->setDefaultSectionSize(ui->contactsView->fontMetrics().height() + 6);
     int presenceColumn = m_contactsModel->columns().indexOf(CContactsModel::Column::Presence);
     ui->contactsView->setItemDelegateForColumn(presenceColumn, new CComboBoxDelegate(this));
 
+    m_rosterImporter = new RosterImporter(this);
+    m_rosterImporter->setModel(m_contactsModel);
+    m_rosterImporter->setService(m_service);
+    connect(m_rosterImporter, &RosterImporter::progress, this, [this](qint64 processedBytes, qint64 totalBytes) {
+        ui->contactListImportProgress->setValue(totalBytes ? static_cast<int>(processedBytes * 1000 / totalBytes) : 0);
+    });
+    connect(m_rosterImporter, &RosterImporter::finished, this, &MainWindow::onRosterImportFinished);
+
     QCompleter *contactsCompleter = new QCompleter(this);
     contactsCompleter->setModel(m_contactsModel);
     int identifierColumn = m_contactsModel->columns().indexOf(CContactsModel::Column::Identifier);
     contactsCompleter->setCompletionColumn(identifierColumn);
 
+    m_messagesLogModel = new CMessagesLogModel(this);
+
+    QSortFilterProxyModel *allMessagesFilter = new QSortFilterProxyModel(this);
+    allMessagesFilter->setSourceModel(m_messagesLogModel);
+    allMessagesFilter->setFilterRole(CMessagesLogModel::ChatRole);
+    allMessagesFilter->setFilterCaseSensitivity(Qt::CaseInsensitive);
+    connect(ui->allMessagesLogFilter, &QLineEdit::textChanged,
+            allMessagesFilter, &QSortFilterProxyModel::setFilterFixedString);
+    ui->allMessagesLog->setModel(allMessagesFilter);
+    keepScrolledToBottom(ui->allMessagesLog);
+
+    CConversationModel *conversationModel = new CConversationModel(this);
+    conversationModel->setSourceModel(m_messagesLogModel);
+    connect(ui->messagingSenderName, &QLineEdit::textChanged,
+            conversationModel, &CConversationModel::setChat);
+    ui->messagesLog->setModel(conversationModel);
+    keepScrolledToBottom(ui->messagesLog);
+
     ui->messagingSenderName->setCompleter(contactsCompleter);
     ui->messagingSenderName->installEventFilter(this);
     ui->messageEdit->installEventFilter(this);
@@ -88,9 +132,32 @@ MainWindow::~MainWindow()
     if (m_service->isRunning()) {
         stopService();
     }
+    if (!m_traceFileName.isEmpty()) {
+        m_service->stopTracing(m_traceFileName);
+    }
+    delete m_recorder;
     delete ui;
 }
 
+bool MainWindow::startRecording(const QString &fileName)
+{
+    if (!m_recorder) {
+        m_recorder = new SimpleCM::TrafficRecorder();
+    }
+    if (!m_recorder->open(fileName)) {
+        return false;
+    }
+
+    m_service->setTrafficRecorder(m_recorder);
+    return true;
+}
+
+void MainWindow::startTracing(const QString &fileName)
+{
+    m_traceFileName = fileName;
+    m_service->startTracing();
+}
+
 void MainWindow::on_registerButton_clicked(bool checked)
 {
     if (checked) {
@@ -108,15 +175,48 @@ void MainWindow::on_registerButton_clicked(bool checked)
 
 void MainWindow::on_contactListAddContact_clicked()
 {
-    QString contact = ui->addContactNameLineEdit->text();
-    if (contact.isEmpty()) {
+    // A pasted list of identifiers is added as one batch
+    static const QRegularExpression separators(QStringLiteral("[\\s,;]+"));
+    const QStringList contacts = ui->addContactNameLineEdit->text().split(separators, c_skipEmptyParts);
+    if (contacts.isEmpty()) {
         return;
     }
 
-    m_contactsModel->ensureContact(contact);
+    m_contactsModel->addContacts(contacts);
     ui->addContactNameLineEdit->clear();
 }
 
+void MainWindow::on_contactListImport_clicked()
+{
+    if (m_rosterImporter->isRunning()) {
+        m_rosterImporter->cancel();
+        return;
+    }
+
+    const QString fileName = QFileDialog::getOpenFileName(this, tr("Import roster"), QString(),
+                                                          tr("Rosters (*.csv *.jsonl *.ndjson);;All files (*)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    ui->contactListImportProgress->setValue(0);
+    ui->contactListImport->setText(tr("Cancel import"));
+    m_rosterImporter->start(fileName);
+}
+
+void MainWindow::onRosterImportFinished(int contacts, bool canceled, const QString &error)
+{
+    ui->contactListImport->setText(tr("Import..."));
+    if (!error.isEmpty()) {
+        statusBar()->showMessage(tr("Unable to import the roster: %1").arg(error));
+    } else if (canceled) {
+        statusBar()->showMessage(tr("Roster import canceled after %n contact(s)", nullptr, contacts));
+    } else {
+        ui->contactListImportProgress->setValue(ui->contactListImportProgress->maximum());
+        statusBar()->showMessage(tr("Imported %n contact(s)", nullptr, contacts));
+    }
+}
+
 void MainWindow::sendPlainMessage()
 {
     if (!m_service->isRunning()) {
@@ -150,12 +250,13 @@ void MainWindow::sendJsonMessage()
     message.chat = SimpleCM::Chat::fromContactId(targetId);
     message.text = QLatin1String("<JSON>");
 
-    logMessage(message);
+    logMessage(message, /* fromRemoteUser */ true);
 }
 
 void MainWindow::onNewMessage(const SimpleCM::Message &message)
 {
-    logMessage(message);
+    // The service reports the messages sent by the local account's clients
+    logMessage(message, /* fromRemoteUser */ false);
 }
 
 void MainWindow::addMessage(const QString &targetContact, const QString &text)
@@ -168,38 +269,37 @@ void MainWindow::addMessage(const QString &targetContact, const QString &text)
     m_service->addMessage(message);
 }
 
-void MainWindow::logMessage(const SimpleCM::Message &message)
+void MainWindow::logMessage(const SimpleCM::Message &message, bool fromRemoteUser)
 {
-    QString peerContact;
     if (message.chat.type == SimpleCM::Chat::Type::Contact) {
-        peerContact = message.chat.identifier;
-        m_contactsModel->ensureContact(peerContact);
+        m_contactsModel->ensureContact(message.chat.identifier);
     }
 
-    QString logText = tr("Message in chat with %1 from %2\n").arg(peerContact, message.from);
-    ui->allMessagesLog->appendPlainText(logText);
+    m_messagesLogModel->appendMessage(message.chat.identifier, message.from, message.text, fromRemoteUser);
+}
 
-    if (ui->messagingSenderName->text() == peerContact) {
-        bool fromRemoteUser = message.chat.identifier == message.from;
-        if (fromRemoteUser) {
-            ui->messagesLog->appendPlainText("< " + message.text);
-        } else {
-            ui->messagesLog->appendPlainText("> " + message.text);
+void MainWindow::keepScrolledToBottom(QListView *view)
+{
+    // Follow the new rows unless the user has scrolled up to read the history
+    QSharedPointer<bool> wasAtBottom = QSharedPointer<bool>::create(true);
+    connect(view->model(), &QAbstractItemModel::rowsAboutToBeInserted, view, [view, wasAtBottom]() {
+        const QScrollBar *bar = view->verticalScrollBar();
+        *wasAtBottom = bar->value() == bar->maximum();
+    });
+    connect(view->model(), &QAbstractItemModel::rowsInserted, view, [view, wasAtBottom]() {
+        if (*wasAtBottom) {
+            view->scrollToBottom();
         }
-    }
+    });
 }
 
 void MainWindow::startService(const QString &cmName, const QString &protocolName)
 {
-    m_service->setManagerName(cmName);
-    m_service->setProtocolName(protocolName);
-
-    m_service->prepare();
-    SimpleCM::ServiceLowLevel *lowLevel = m_service->lowLevel();
-    Tp::BaseProtocolPtr protocol = lowLevel->getProtocol();
-    protocol->setVCardField(ui->protocolAddressibleVCardFields->text());
-    protocol->setEnglishName(ui->protocolDisplayName->text());
-    protocol->setIconName(ui->protocolIcon->text());
+    ManagerPreset preset(cmName, protocolName);
+    preset.protocolDisplayName = ui->protocolDisplayName->text();
+    preset.protocolIcon = ui->protocolIcon->text();
+    preset.addressableVCardFields = ui->protocolAddressibleVCardFields->text().split(QLatin1Char(';'), c_skipEmptyParts);
+    prepareService(m_service, preset);
 
     m_service->start();
 
@@ -14,12 +14,17 @@ namespace SimpleCM {
 
 class Service;
 class Message;
+class TrafficRecorder;
 
 } // SimpleCM
 
 class SimpleProtocol;
 
 class CContactsModel;
+class CMessagesLogModel;
+class RosterImporter;
+
+class QListView;
 
 class MainWindow : public QMainWindow
 {
@@ -29,10 +34,15 @@ public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
 
+    bool startRecording(const QString &fileName);
+    void startTracing(const QString &fileName);
+
 private slots:
     void on_registerButton_clicked(bool checked);
 
     void on_contactListAddContact_clicked();
+    void on_contactListImport_clicked();
+    void onRosterImportFinished(int contacts, bool canceled, const QString &error);
     void sendPlainMessage();
     void sendJsonMessage();
 
@@ -62,7 +72,8 @@ private:
     QString getSelectedAccount() const;
     QString getAccountId(const QModelIndex &accountIndex) const;
 
-    void logMessage(const SimpleCM::Message &message);
+    void logMessage(const SimpleCM::Message &message, bool fromRemoteUser);
+    void keepScrolledToBottom(QListView *view);
 
     static QString accountStatusToString(AccountHelper::AccountStatus status);
 
@@ -71,7 +82,11 @@ private:
     QList<ManagerPreset> m_presets;
     SimpleCM::Service *m_service = nullptr;
     CContactsModel *m_contactsModel = nullptr;
+    CMessagesLogModel *m_messagesLogModel = nullptr;
+    RosterImporter *m_rosterImporter = nullptr;
     AccountHelper *m_accountHelper = nullptr;
+    SimpleCM::TrafficRecorder *m_recorder = nullptr;
+    QString m_traceFileName;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,254 @@
+#include "RosterImporter.hpp"
+
+#include "CContactsModel.hpp"
+
+#include <SimpleCM/Service>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QThread>
+
+#include <cstring>
+
+Q_LOGGING_CATEGORY(lcSimpleRosterImporter, "simple.rosterImporter", QtWarningMsg)
+
+// Bounds the parsed contacts waiting for the UI thread
+static const int c_maxChunksInFlight = 4;
+// The parser checks for a cancellation this often while waiting for the UI thread
+static const int c_creditWaitInterval = 50;
+
+static bool isCsvHeader(const QString &field)
+{
+    return (field.compare(QLatin1String("id"), Qt::CaseInsensitive) == 0)
+            || (field.compare(QLatin1String("identifier"), Qt::CaseInsensitive) == 0)
+            || (field.compare(QLatin1String("contact"), Qt::CaseInsensitive) == 0);
+}
+
+RosterParser::RosterParser(QSemaphore *credits, QAtomicInt *canceled)
+    : QObject(nullptr),
+      m_credits(credits),
+      m_canceled(canceled)
+{
+}
+
+void RosterParser::parse(const QString &fileName, Format format, int chunkSize)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        emit finished(file.errorString());
+        return;
+    }
+
+    const qint64 fileSize = file.size();
+    if (fileSize == 0) {
+        emit finished(QString());
+        return;
+    }
+
+    uchar *data = file.map(0, fileSize);
+    if (!data) {
+        emit finished(file.errorString());
+        return;
+    }
+
+    const char *begin = reinterpret_cast<const char *>(data);
+    const char *end = begin + fileSize;
+    QStringList identifiers;
+    identifiers.reserve(chunkSize);
+    QString identifier;
+    bool canceled = false;
+
+    for (const char *line = begin; line < end; ) {
+        const char *lineEnd = static_cast<const char *>(memchr(line, '\n', static_cast<size_t>(end - line)));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+        int length = static_cast<int>(lineEnd - line);
+        if (length && (line[length - 1] == '\r')) {
+            --length;
+        }
+
+        if (parseLine(line, length, format, &identifier)) {
+            const bool isHeader = (line == begin) && (format == Format::Csv) && isCsvHeader(identifier);
+            if (!isHeader) {
+                identifiers.append(identifier);
+            }
+        }
+        line = lineEnd + 1;
+
+        if ((identifiers.count() >= chunkSize) && !emitChunk(&identifiers, qMin<qint64>(line - begin, fileSize), fileSize)) {
+            canceled = true;
+            break;
+        }
+    }
+    if (!canceled && !identifiers.isEmpty()) {
+        emitChunk(&identifiers, fileSize, fileSize);
+    }
+
+    file.unmap(data);
+    emit finished(QString());
+}
+
+bool RosterParser::parseLine(const char *line, int length, Format format, QString *identifier)
+{
+    if (format == Format::JsonLines) {
+        if (!length) {
+            return false;
+        }
+        const QJsonDocument document = QJsonDocument::fromJson(QByteArray::fromRawData(line, length));
+        QJsonValue value;
+        if (document.isObject()) {
+            const QJsonObject object = document.object();
+            value = object.contains(QLatin1String("id")) ? object.value(QLatin1String("id"))
+                                                         : object.value(QLatin1String("identifier"));
+        } else if (document.isArray()) {
+            value = document.array().at(0);
+        }
+        *identifier = value.toString().trimmed();
+        return !identifier->isEmpty();
+    }
+
+    // The identifier is the first CSV field, optionally quoted
+    int start = 0;
+    while ((start < length) && ((line[start] == ' ') || (line[start] == '\t'))) {
+        ++start;
+    }
+    if ((start < length) && (line[start] == '"')) {
+        QByteArray field;
+        for (int i = start + 1; i < length; ++i) {
+            if (line[i] == '"') {
+                if ((i + 1 < length) && (line[i + 1] == '"')) {
+                    field.append('"');
+                    ++i;
+                    continue;
+                }
+                break;
+            }
+            field.append(line[i]);
+        }
+        *identifier = QString::fromUtf8(field).trimmed();
+    } else {
+        const void *separator = memchr(line + start, ',', static_cast<size_t>(length - start));
+        const int fieldEnd = separator ? static_cast<int>(static_cast<const char *>(separator) - line) : length;
+        *identifier = QString::fromUtf8(line + start, fieldEnd - start).trimmed();
+    }
+    return !identifier->isEmpty();
+}
+
+bool RosterParser::emitChunk(QStringList *identifiers, qint64 processedBytes, qint64 totalBytes)
+{
+    while (!m_credits->tryAcquire(1, c_creditWaitInterval)) {
+        if (m_canceled->loadAcquire()) {
+            return false;
+        }
+    }
+    if (m_canceled->loadAcquire()) {
+        m_credits->release();
+        return false;
+    }
+
+    const int chunkSize = identifiers->count();
+    emit chunkParsed(*identifiers, processedBytes, totalBytes);
+    *identifiers = QStringList();
+    identifiers->reserve(chunkSize);
+    return true;
+}
+
+RosterImporter::RosterImporter(QObject *parent)
+    : QObject(parent)
+{
+    m_thread = new QThread();
+    m_thread->setObjectName(QStringLiteral("RosterImporter"));
+    m_parser = new RosterParser(&m_credits, &m_canceled);
+    m_parser->moveToThread(m_thread);
+    connect(m_thread, &QThread::finished, m_parser, &QObject::deleteLater);
+    connect(m_parser, &RosterParser::chunkParsed, this, &RosterImporter::onChunkParsed);
+    connect(m_parser, &RosterParser::finished, this, &RosterImporter::onParsingFinished);
+    m_thread->start();
+}
+
+RosterImporter::~RosterImporter()
+{
+    m_canceled.storeRelease(1);
+    m_thread->quit();
+    m_thread->wait();
+    delete m_thread;
+}
+
+void RosterImporter::setModel(CContactsModel *model)
+{
+    m_model = model;
+}
+
+void RosterImporter::setService(SimpleCM::Service *service)
+{
+    m_service = service;
+}
+
+void RosterImporter::setChunkSize(int size)
+{
+    m_chunkSize = qMax(1, size);
+}
+
+bool RosterImporter::isRunning() const
+{
+    return m_running;
+}
+
+void RosterImporter::start(const QString &fileName)
+{
+    if (m_running) {
+        qCWarning(lcSimpleRosterImporter) << __func__ << "An import is already running";
+        return;
+    }
+    m_running = true;
+    m_contacts = 0;
+    m_canceled.storeRelease(0);
+    m_credits.acquire(m_credits.available());
+    m_credits.release(c_maxChunksInFlight);
+
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    const RosterParser::Format format = (suffix == QLatin1String("jsonl")) || (suffix == QLatin1String("ndjson"))
+            ? RosterParser::Format::JsonLines
+            : RosterParser::Format::Csv;
+    const int chunkSize = m_chunkSize;
+    RosterParser *parser = m_parser;
+    QMetaObject::invokeMethod(m_parser, [parser, fileName, format, chunkSize]() {
+        parser->parse(fileName, format, chunkSize);
+    }, Qt::QueuedConnection);
+}
+
+void RosterImporter::cancel()
+{
+    m_canceled.storeRelease(1);
+}
+
+void RosterImporter::onChunkParsed(const QStringList &identifiers, qint64 processedBytes, qint64 totalBytes)
+{
+    // A chunk at a time keeps the UI thread work per event loop iteration bounded
+    if (!m_canceled.loadAcquire()) {
+        if (m_model) {
+            m_model->addContacts(identifiers);
+        }
+        if (m_service && m_service->isRunning()) {
+            m_service->setContactList(identifiers);
+        }
+        m_contacts += identifiers.count();
+    }
+    m_credits.release();
+
+    emit progress(processedBytes, totalBytes, m_contacts);
+}
+
+void RosterImporter::onParsingFinished(const QString &error)
+{
+    if (!error.isEmpty()) {
+        qCWarning(lcSimpleRosterImporter) << "Unable to import the roster:" << error;
+    }
+    m_running = false;
+    emit finished(m_contacts, m_canceled.loadAcquire(), error);
+}
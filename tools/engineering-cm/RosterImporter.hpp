@@ -0,0 +1,87 @@
+#ifndef SIMPLE_ROSTER_IMPORTER_HPP
+#define SIMPLE_ROSTER_IMPORTER_HPP
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QPointer>
+#include <QSemaphore>
+#include <QStringList>
+
+QT_FORWARD_DECLARE_CLASS(QThread)
+
+namespace SimpleCM {
+
+class Service;
+
+} // SimpleCM
+
+class CContactsModel;
+
+/* Parses the roster file on the importer thread and hands it over in chunks */
+class RosterParser : public QObject
+{
+    Q_OBJECT
+public:
+    enum class Format {
+        Csv,
+        JsonLines,
+    };
+
+    explicit RosterParser(QSemaphore *credits, QAtomicInt *canceled);
+
+public slots:
+    void parse(const QString &fileName, Format format, int chunkSize);
+
+signals:
+    void chunkParsed(const QStringList &identifiers, qint64 processedBytes, qint64 totalBytes);
+    void finished(const QString &error);
+
+protected:
+    bool parseLine(const char *line, int length, Format format, QString *identifier);
+    bool emitChunk(QStringList *identifiers, qint64 processedBytes, qint64 totalBytes);
+
+    QSemaphore *m_credits = nullptr;
+    QAtomicInt *m_canceled = nullptr;
+};
+
+/* Imports a CSV (identifier in the first column) or JSON Lines roster into the contacts model and the service */
+class RosterImporter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RosterImporter(QObject *parent = nullptr);
+    ~RosterImporter() override;
+
+    void setModel(CContactsModel *model);
+    void setService(SimpleCM::Service *service);
+    void setChunkSize(int size);
+
+    bool isRunning() const;
+
+public slots:
+    void start(const QString &fileName);
+    void cancel();
+
+signals:
+    void progress(qint64 processedBytes, qint64 totalBytes, int contacts);
+    void finished(int contacts, bool canceled, const QString &error);
+
+protected slots:
+    void onChunkParsed(const QStringList &identifiers, qint64 processedBytes, qint64 totalBytes);
+    void onParsingFinished(const QString &error);
+
+protected:
+    QPointer<CContactsModel> m_model;
+    QPointer<SimpleCM::Service> m_service;
+    int m_chunkSize = 2000;
+
+    QThread *m_thread = nullptr;
+    RosterParser *m_parser = nullptr;
+    // The chunks the parser may have in flight
+    QSemaphore m_credits;
+    QAtomicInt m_canceled;
+    bool m_running = false;
+    int m_contacts = 0;
+};
+
+#endif // SIMPLE_ROSTER_IMPORTER_HPP
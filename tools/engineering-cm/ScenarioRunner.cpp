@@ -0,0 +1,488 @@
+#include "ScenarioRunner.hpp"
+
+#include "AccountHelper.hpp"
+#include "AccountProvisioner.hpp"
+#include "CContactsModel.hpp"
+#include "PresetsLoader.hpp"
+#include "ServicePreset.hpp"
+
+#ifndef SIMPLECM_ENABLE_LOWLEVEL_API
+#define SIMPLECM_ENABLE_LOWLEVEL_API
+#endif
+
+#include <SimpleCM/Chat>
+#include <SimpleCM/Message>
+#include <SimpleCM/Service>
+#include <SimpleCM/ServiceLowLevel>
+#include <SimpleCM/TrafficReplayer>
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QLoggingCategory>
+#include <QSharedPointer>
+#include <QTextStream>
+
+
+Q_LOGGING_CATEGORY(lcSimpleScenario, "simple.scenario", QtWarningMsg)
+
+static const int c_defaultTimeout = 30000;
+// The synchronous steps yield to the event loop after this long
+static const int c_sliceDuration = 10;
+static const QString c_iterationToken = QStringLiteral("{i}");
+
+static QJsonValue substitutedValue(const QJsonValue &value, const QString &iteration)
+{
+    switch (value.type()) {
+    case QJsonValue::String:
+        return value.toString().replace(c_iterationToken, iteration);
+    case QJsonValue::Array: {
+        QJsonArray array;
+        for (const QJsonValue &item : value.toArray()) {
+            array.append(substitutedValue(item, iteration));
+        }
+        return array;
+    }
+    case QJsonValue::Object: {
+        QJsonObject object = value.toObject();
+        for (auto it = object.begin(); it != object.end(); ++it) {
+            it.value() = substitutedValue(it.value(), iteration);
+        }
+        return object;
+    }
+    default:
+        return value;
+    }
+}
+
+ScenarioRunner::ScenarioRunner(QObject *parent)
+    : QObject(parent),
+      m_service(new SimpleCM::Service(this)),
+      m_accountHelper(new AccountHelper(this)),
+      m_provisioner(new AccountProvisioner(this)),
+      m_contactsModel(new CContactsModel(this))
+{
+    m_contactsModel->setColumns({
+                                    CContactsModel::Column::Identifier,
+                                    CContactsModel::Column::Handle,
+                                    CContactsModel::Column::Presence,
+                                });
+    m_contactsModel->setService(m_service);
+
+    connect(m_service, &SimpleCM::Service::newMessage, this, [this]() {
+        ++m_receivedMessages;
+    });
+    connect(m_provisioner, &AccountProvisioner::finished, this, [this]() {
+        m_provisioningFinished = true;
+    });
+
+    m_pollTimer.setTimerType(Qt::PreciseTimer);
+    m_pollTimer.setInterval(1);
+    connect(&m_pollTimer, &QTimer::timeout, this, &ScenarioRunner::pollCondition);
+}
+
+ScenarioRunner::~ScenarioRunner()
+{
+    if (m_service->isRunning()) {
+        m_accountHelper->stop();
+        m_service->stop();
+    }
+}
+
+SimpleCM::Service *ScenarioRunner::service() const
+{
+    return m_service;
+}
+
+bool ScenarioRunner::load(const QString &fileName, QString *errorMessage)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorMessage) {
+            *errorMessage = file.errorString();
+        }
+        return false;
+    }
+
+    QJsonParseError parseError;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (parseError.error != QJsonParseError::NoError) {
+        if (errorMessage) {
+            *errorMessage = parseError.errorString();
+        }
+        return false;
+    }
+
+    // Either a steps array or an object with the steps
+    m_steps = document.isArray() ? document.array() : document.object().value(QLatin1String("steps")).toArray();
+    m_fileName = fileName;
+    return true;
+}
+
+void ScenarioRunner::printReport(QTextStream &out) const
+{
+    out << "Scenario " << m_fileName << (m_succeeded ? " succeeded" : " failed")
+        << " in " << m_finishedAt / 1000.0 << " ms" << '\n';
+    if (!m_error.isEmpty()) {
+        out << "Error: " << m_error << '\n';
+    }
+
+    for (const StepTimings &timings : m_timings) {
+        qint64 total = 0;
+        for (qint64 duration : timings.durations) {
+            total += duration;
+        }
+        out << timings.label << ": count " << timings.durations.count()
+            << " total " << total / 1000.0 << " ms"
+            << " p50 " << SimpleCM::TrafficReplayReport::percentile(timings.durations, 50) / 1000.0 << " ms"
+            << " p99 " << SimpleCM::TrafficReplayReport::percentile(timings.durations, 99) / 1000.0 << " ms"
+            << " max " << SimpleCM::TrafficReplayReport::percentile(timings.durations, 100) / 1000.0 << " ms" << '\n';
+    }
+    for (const LoopReport &loop : m_loops) {
+        const double rate = loop.duration > 0 ? loop.iterations * 1000000.0 / loop.duration : 0;
+        out << "Loop " << loop.label << ": " << loop.iterations << " iterations"
+            << " in " << loop.duration / 1000.0 << " ms (" << rate << "/s)" << '\n';
+    }
+    out.flush();
+}
+
+void ScenarioRunner::start()
+{
+    if (m_running) {
+        return;
+    }
+
+    Frame frame;
+    frame.label = QStringLiteral("scenario");
+    frame.steps = m_steps;
+    m_frames = { frame };
+    m_timings.clear();
+    m_timingIndices.clear();
+    m_loops.clear();
+    m_error.clear();
+    m_receivedMessages = 0;
+    m_running = true;
+    m_clock.start();
+
+    QTimer::singleShot(0, this, &ScenarioRunner::runSteps);
+}
+
+void ScenarioRunner::runSteps()
+{
+    QElapsedTimer slice;
+    slice.start();
+
+    while (m_running && !m_waitCondition) {
+        if (m_frames.isEmpty()) {
+            finish(true);
+            return;
+        }
+
+        Frame &frame = m_frames.last();
+        if (frame.index < frame.steps.count()) {
+            const QJsonObject step = frame.steps.at(frame.index++).toObject();
+            // Only the innermost loop substitutes its iteration number
+            runStep(m_frames.count() > 1 ? substituted(step, frame.iteration) : step);
+        } else if (++frame.iteration < frame.iterations) {
+            frame.index = 0;
+            if (frame.rate > 0) {
+                const qint64 due = frame.startedAt + static_cast<qint64>(frame.iteration * 1000000.0 / frame.rate);
+                waitFor(QString(), now(), -1, [this, due]() {
+                    return now() >= due;
+                });
+            }
+        } else {
+            if (m_frames.count() > 1) {
+                LoopReport loop;
+                loop.label = frame.label;
+                loop.iterations = frame.iterations;
+                loop.duration = now() - frame.startedAt;
+                m_loops.append(loop);
+            }
+            m_frames.removeLast();
+        }
+
+        // Let the event loop deliver the D-Bus traffic during the long synchronous runs
+        if (m_running && !m_waitCondition && slice.hasExpired(c_sliceDuration)) {
+            QTimer::singleShot(0, this, &ScenarioRunner::runSteps);
+            return;
+        }
+    }
+}
+
+void ScenarioRunner::pollCondition()
+{
+    if (!m_waitCondition) {
+        m_pollTimer.stop();
+        return;
+    }
+
+    if (m_waitCondition()) {
+        m_pollTimer.stop();
+        m_waitCondition = nullptr;
+        if (!m_waitLabel.isEmpty()) {
+            record(m_waitLabel, now() - m_waitStartedAt);
+        }
+        runSteps();
+        return;
+    }
+
+    if (m_waitDeadline && (now() > m_waitDeadline)) {
+        fail(QStringLiteral("%1 timed out").arg(m_waitLabel));
+    }
+}
+
+void ScenarioRunner::runStep(const QJsonObject &step)
+{
+    const QString action = step.value(QLatin1String("action")).toString();
+    const QString label = step.value(QLatin1String("name")).toString(action);
+    const int timeout = step.value(QLatin1String("timeout")).toInt(c_defaultTimeout);
+    const qint64 startedAt = now();
+    qCDebug(lcSimpleScenario) << __func__ << label;
+
+    if (action == QLatin1String("loop")) {
+        Frame frame;
+        frame.label = label;
+        frame.steps = step.value(QLatin1String("steps")).toArray();
+        frame.iterations = step.value(QLatin1String("count")).toInt(1);
+        frame.rate = step.value(QLatin1String("rate")).toDouble();
+        frame.startedAt = startedAt;
+        if (frame.iterations > 0) {
+            m_frames.append(frame);
+        }
+        return;
+    }
+
+    if (action == QLatin1String("start")) {
+        startService(step);
+    } else if (action == QLatin1String("stop")) {
+        m_accountHelper->stop();
+        m_service->stop();
+    } else if (action == QLatin1String("addAccount")) {
+        const int accountCount = m_accountHelper->accountIds().count();
+        m_accountHelper->addAccount();
+        waitFor(label, startedAt, timeout, [this, accountCount]() {
+            return m_accountHelper->accountIds().count() > accountCount;
+        });
+        return;
+    } else if (action == QLatin1String("connectAccount")) {
+        const QString accountId = step.value(QLatin1String("account")).toString();
+        QSharedPointer<bool> requested = QSharedPointer<bool>::create(false);
+        // The accounts may still be loading
+        waitFor(label, startedAt, timeout, [this, accountId, requested]() {
+            if (m_accountHelper->currentAccountStatus() == AccountHelper::AccountStatus::Connected) {
+                return true;
+            }
+            if (!*requested) {
+                const QStringList accountIds = m_accountHelper->accountIds();
+                const QString identifier = accountId.isEmpty() && !accountIds.isEmpty() ? accountIds.constFirst() : accountId;
+                if (accountIds.contains(identifier)) {
+                    *requested = true;
+                    m_accountHelper->connectAccount(identifier);
+                }
+            }
+            return false;
+        });
+        return;
+    } else if (action == QLatin1String("disconnectAccount")) {
+        const QString accountId = step.value(QLatin1String("account")).toString(m_accountHelper->currentAccountId());
+        m_accountHelper->disconnectAccount(accountId);
+    } else if (action == QLatin1String("provisionAccounts")) {
+        m_provisioner->setManagerName(m_preset.name);
+        m_provisioner->setProtocolName(m_preset.protocol);
+        m_provisioner->setConcurrency(step.value(QLatin1String("concurrency")).toInt(8));
+        m_provisioner->setSelfIdPattern(step.value(QLatin1String("selfId")).toString(QStringLiteral("provisioned_%1")));
+        m_provisioner->setTimeout(timeout);
+        m_provisioningFinished = false;
+        m_provisioner->provision(step.value(QLatin1String("count")).toInt());
+        waitFor(label, startedAt, -1, [this]() {
+            return m_provisioningFinished;
+        });
+        return;
+    } else if (action == QLatin1String("addContacts")) {
+        m_contactsModel->addContacts(contactsOf(step));
+    } else if (action == QLatin1String("setPresence")) {
+        const int presenceColumn = m_contactsModel->columns().indexOf(CContactsModel::Column::Presence);
+        const QString presence = step.value(QLatin1String("presence")).toString();
+        for (const QString &contact : contactsOf(step)) {
+            const int row = m_contactsModel->rowOf(contact);
+            if (row < 0) {
+                fail(QStringLiteral("%1: unknown contact %2").arg(label, contact));
+                return;
+            }
+            if (!m_contactsModel->setData(m_contactsModel->index(row, presenceColumn), presence)) {
+                fail(QStringLiteral("%1: unable to set presence %2").arg(label, presence));
+                return;
+            }
+        }
+    } else if (action == QLatin1String("sendMessage")) {
+        const QString from = step.value(QLatin1String("from")).toString();
+        SimpleCM::Message message;
+        message.from = from;
+        message.chat = SimpleCM::Chat::fromContactId(from);
+        message.text = step.value(QLatin1String("text")).toString();
+        m_service->addMessage(message);
+    } else if (action == QLatin1String("sendJson")) {
+        const QJsonValue json = step.value(QLatin1String("json"));
+        const QByteArray data = json.isString() ? json.toString().toUtf8()
+                                                : json.isArray() ? QJsonDocument(json.toArray()).toJson(QJsonDocument::Compact)
+                                                                 : QJsonDocument(json.toObject()).toJson(QJsonDocument::Compact);
+        const SimpleCM::Chat peer = SimpleCM::Chat::fromContactId(step.value(QLatin1String("from")).toString());
+        m_service->lowLevel()->sendJsonMessage(peer, data);
+    } else if (action == QLatin1String("wait")) {
+        const qint64 due = startedAt + step.value(QLatin1String("msecs")).toInt() * 1000;
+        waitFor(label, startedAt, -1, [this, due]() {
+            return now() >= due;
+        });
+        return;
+    } else if (action == QLatin1String("waitFor")) {
+        const QString condition = step.value(QLatin1String("condition")).toString();
+        const int count = step.value(QLatin1String("count")).toInt();
+        if (condition == QLatin1String("accountConnected")) {
+            waitFor(label, startedAt, timeout, [this]() {
+                return m_accountHelper->currentAccountStatus() == AccountHelper::AccountStatus::Connected;
+            });
+        } else if (condition == QLatin1String("contactsResolved")) {
+            waitFor(label, startedAt, timeout, [this]() {
+                return !m_contactsModel->hasPendingResolves();
+            });
+        } else if (condition == QLatin1String("messagesReceived")) {
+            waitFor(label, startedAt, timeout, [this, count]() {
+                return m_receivedMessages >= count;
+            });
+        } else {
+            fail(QStringLiteral("%1: unknown condition %2").arg(label, condition));
+        }
+        return;
+    } else {
+        fail(QStringLiteral("Unknown action %1").arg(action));
+        return;
+    }
+
+    if (m_running) {
+        record(label, now() - startedAt);
+    }
+}
+
+void ScenarioRunner::startService(const QJsonObject &step)
+{
+    if (m_service->isRunning()) {
+        return;
+    }
+
+    const QList<ManagerPreset> presets = PresetsLoader::presets();
+    ManagerPreset preset = presets.constFirst();
+    const QString presetName = step.value(QLatin1String("preset")).toString(preset.name);
+    for (const ManagerPreset &candidate : presets) {
+        if (candidate.name == presetName) {
+            preset = candidate;
+            break;
+        }
+    }
+    preset.name = step.value(QLatin1String("manager")).toString(preset.name);
+    preset.protocol = step.value(QLatin1String("protocol")).toString(preset.protocol);
+
+    prepareService(m_service, preset);
+    if (!m_service->start()) {
+        fail(QStringLiteral("Unable to start the service %1").arg(preset.name));
+        return;
+    }
+
+    m_preset = preset;
+    m_accountHelper->setManagerName(preset.name);
+    m_accountHelper->setProtocolName(preset.protocol);
+    m_accountHelper->start();
+}
+
+void ScenarioRunner::waitFor(const QString &label, qint64 startedAt, int timeout, const std::function<bool()> &condition)
+{
+    if (condition()) {
+        if (!label.isEmpty()) {
+            record(label, now() - startedAt);
+        }
+        return;
+    }
+
+    m_waitLabel = label;
+    m_waitStartedAt = startedAt;
+    m_waitDeadline = timeout < 0 ? 0 : startedAt + qint64(timeout) * 1000;
+    m_waitCondition = condition;
+    m_pollTimer.start();
+}
+
+void ScenarioRunner::finish(bool succeeded)
+{
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+    m_succeeded = succeeded;
+    m_waitCondition = nullptr;
+    m_pollTimer.stop();
+    m_finishedAt = now();
+
+    emit finished(succeeded);
+}
+
+void ScenarioRunner::fail(const QString &error)
+{
+    qCWarning(lcSimpleScenario) << error;
+    m_error = error;
+    finish(false);
+}
+
+void ScenarioRunner::record(const QString &label, qint64 duration)
+{
+    int index = m_timingIndices.value(label, -1);
+    if (index < 0) {
+        index = m_timings.count();
+        m_timingIndices.insert(label, index);
+        StepTimings timings;
+        timings.label = label;
+        m_timings.append(timings);
+    }
+    m_timings[index].durations.append(duration);
+}
+
+QJsonObject ScenarioRunner::substituted(const QJsonObject &step, int iteration) const
+{
+    const QString iterationText = QString::number(iteration);
+    QJsonObject result = step;
+    for (auto it = result.begin(); it != result.end(); ++it) {
+        // The nested loops substitute their own iterations
+        if (it.key() == QLatin1String("steps")) {
+            continue;
+        }
+        it.value() = substitutedValue(it.value(), iterationText);
+    }
+    return result;
+}
+
+QStringList ScenarioRunner::contactsOf(const QJsonObject &step) const
+{
+    if (step.contains(QLatin1String("contact"))) {
+        return QStringList() << step.value(QLatin1String("contact")).toString();
+    }
+    if (step.contains(QLatin1String("contacts"))) {
+        QStringList contacts;
+        for (const QJsonValue &contact : step.value(QLatin1String("contacts")).toArray()) {
+            contacts << contact.toString();
+        }
+        return contacts;
+    }
+
+    // A generated range, e.g. { "count": 1000, "pattern": "contact_%1", "first": 1 }
+    const QString pattern = step.value(QLatin1String("pattern")).toString(QStringLiteral("contact_%1"));
+    const int first = step.value(QLatin1String("first")).toInt(1);
+    const int count = step.value(QLatin1String("count")).toInt();
+    QStringList contacts;
+    contacts.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        contacts << pattern.arg(first + i);
+    }
+    return contacts;
+}
+
+qint64 ScenarioRunner::now() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
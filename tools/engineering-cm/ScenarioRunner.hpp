@@ -0,0 +1,115 @@
+#ifndef SIMPLE_SCENARIO_RUNNER_HPP
+#define SIMPLE_SCENARIO_RUNNER_HPP
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+#include <functional>
+
+#include "ManagerPreset.hpp"
+
+QT_FORWARD_DECLARE_CLASS(QTextStream)
+
+namespace SimpleCM {
+
+class Service;
+
+} // SimpleCM
+
+class AccountHelper;
+class AccountProvisioner;
+class CContactsModel;
+
+/* Runs a declarative (JSON) scenario on the engineering manager objects without the widgets */
+class ScenarioRunner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ScenarioRunner(QObject *parent = nullptr);
+    ~ScenarioRunner();
+
+    SimpleCM::Service *service() const;
+
+    bool load(const QString &fileName, QString *errorMessage = nullptr);
+    void printReport(QTextStream &out) const;
+
+public slots:
+    void start();
+
+signals:
+    void finished(bool succeeded);
+
+protected slots:
+    void runSteps();
+    void pollCondition();
+
+protected:
+    struct Frame {
+        QString label;
+        QJsonArray steps;
+        int index = 0;
+        int iteration = 0;
+        int iterations = 1;
+        // Iterations per second, 0 for no limit
+        double rate = 0;
+        qint64 startedAt = 0;
+    };
+
+    struct StepTimings {
+        QString label;
+        QVector<qint64> durations;
+    };
+
+    struct LoopReport {
+        QString label;
+        int iterations = 0;
+        qint64 duration = 0;
+    };
+
+    void runStep(const QJsonObject &step);
+    void startService(const QJsonObject &step);
+    void waitFor(const QString &label, qint64 startedAt, int timeout, const std::function<bool()> &condition);
+    void finish(bool succeeded);
+    void fail(const QString &error);
+
+    void record(const QString &label, qint64 duration);
+    QJsonObject substituted(const QJsonObject &step, int iteration) const;
+    QStringList contactsOf(const QJsonObject &step) const;
+    qint64 now() const;
+
+    SimpleCM::Service *m_service = nullptr;
+    AccountHelper *m_accountHelper = nullptr;
+    AccountProvisioner *m_provisioner = nullptr;
+    CContactsModel *m_contactsModel = nullptr;
+
+    ManagerPreset m_preset;
+    QString m_fileName;
+    QJsonArray m_steps;
+    QVector<Frame> m_frames;
+    bool m_running = false;
+    bool m_succeeded = false;
+    QString m_error;
+
+    // The step being waited for
+    QString m_waitLabel;
+    qint64 m_waitStartedAt = 0;
+    qint64 m_waitDeadline = 0;
+    std::function<bool()> m_waitCondition;
+    QTimer m_pollTimer;
+
+    int m_receivedMessages = 0;
+    bool m_provisioningFinished = false;
+
+    QElapsedTimer m_clock;
+    qint64 m_finishedAt = 0;
+    QVector<StepTimings> m_timings;
+    QHash<QString, int> m_timingIndices;
+    QVector<LoopReport> m_loops;
+};
+
+#endif // SIMPLE_SCENARIO_RUNNER_HPP
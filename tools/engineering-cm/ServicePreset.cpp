@@ -0,0 +1,48 @@
+#include "ServicePreset.hpp"
+
+#ifndef SIMPLECM_ENABLE_LOWLEVEL_API
+#define SIMPLECM_ENABLE_LOWLEVEL_API
+#endif
+
+#include <TelepathyQt/BaseProtocol>
+
+#include <SimpleCM/ContactNormalizer>
+#include <SimpleCM/Service>
+#include <SimpleCM/ServiceLowLevel>
+
+void prepareService(SimpleCM::Service *service, const ManagerPreset &preset)
+{
+    service->setManagerName(preset.name);
+    service->setProtocolName(preset.protocol);
+
+    service->prepare();
+    SimpleCM::ServiceLowLevel *lowLevel = service->lowLevel();
+    Tp::BaseProtocolPtr protocol = lowLevel->getProtocol();
+    protocol->setVCardField(preset.addressableVCardFields.join(QLatin1Char(';')));
+    protocol->setEnglishName(preset.protocolDisplayName);
+    protocol->setIconName(preset.protocolIcon);
+
+    // The telephony presets address the contacts by phone numbers
+    QStringList uriSchemes = preset.addressableURISchemes;
+    SimpleCM::ContactNormalizer *normalizer = service->contactNormalizer();
+    if (preset.addressableVCardFields.contains(QLatin1String("tel"), Qt::CaseInsensitive)) {
+        if (!uriSchemes.contains(QLatin1String("tel"), Qt::CaseInsensitive)) {
+            uriSchemes << QLatin1String("tel");
+        }
+        normalizer->setSteps(SimpleCM::ContactNormalizer::TrimWhitespace
+                             | SimpleCM::ContactNormalizer::StripUriScheme
+                             | SimpleCM::ContactNormalizer::PhoneE164
+                             | SimpleCM::ContactNormalizer::CaseFold);
+        normalizer->setUriSchemes(QStringList() << QLatin1String("tel"));
+    } else {
+        normalizer->setSteps(SimpleCM::ContactNormalizer::TrimWhitespace | SimpleCM::ContactNormalizer::CaseFold);
+        normalizer->setUriSchemes(QStringList());
+    }
+
+    // The protocol normalizes the contact URIs of these schemes ("tel" ones to E.164)
+    Tp::BaseProtocolAddressingInterfacePtr addressing = Tp::BaseProtocolAddressingInterfacePtr::dynamicCast(
+                protocol->interface(TP_QT_IFACE_PROTOCOL_INTERFACE_ADDRESSING));
+    if (addressing && !uriSchemes.isEmpty()) {
+        addressing->setAddressableUriSchemes(uriSchemes);
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef SIMPLE_SERVICE_PRESET_HPP
+#define SIMPLE_SERVICE_PRESET_HPP
+
+#include "ManagerPreset.hpp"
+
+namespace SimpleCM {
+
+class Service;
+
+} // SimpleCM
+
+// Names the service and prepares its protocol and contact normalization for the preset; the service is not started
+void prepareService(SimpleCM::Service *service, const ManagerPreset &preset);
+
+#endif // SIMPLE_SERVICE_PRESET_HPP
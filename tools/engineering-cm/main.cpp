@@ -1,11 +1,105 @@
 #include "MainWindow.hpp"
+#include "ScenarioRunner.hpp"
+
+#include <SimpleCM/Service>
+#include <SimpleCM/TrafficRecorder>
+
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QScopedPointer>
+#include <QTextStream>
+
+// The application type has to be chosen before the arguments are parsed
+static bool isHeadless(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--headless") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int runScenario(QCoreApplication *app, const QString &fileName,
+                       const QString &recordFileName, const QString &traceFileName)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    ScenarioRunner runner;
+    QString errorMessage;
+    if (!runner.load(fileName, &errorMessage)) {
+        err << "Unable to load the scenario " << fileName << ": " << errorMessage << '\n';
+        return 1;
+    }
+
+    SimpleCM::TrafficRecorder recorder;
+    if (!recordFileName.isEmpty()) {
+        if (!recorder.open(recordFileName)) {
+            err << "Unable to open " << recordFileName << '\n';
+            return 1;
+        }
+        runner.service()->setTrafficRecorder(&recorder);
+    }
+    if (!traceFileName.isEmpty()) {
+        runner.service()->startTracing();
+    }
+
+    QObject::connect(&runner, &ScenarioRunner::finished, app, [app](bool succeeded) {
+        app->exit(succeeded ? 0 : 1);
+    });
+    runner.start();
+    const int result = app->exec();
+
+    runner.printReport(out);
+    if (!traceFileName.isEmpty()) {
+        runner.service()->stopTracing(traceFileName);
+    }
+    runner.service()->setTrafficRecorder(nullptr);
+    return result;
+}
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    QScopedPointer<QCoreApplication> a(isHeadless(argc, argv) ? new QCoreApplication(argc, argv)
+                                                              : new QApplication(argc, argv));
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption recordOption(QStringLiteral("record"),
+                                    QStringLiteral("Record the service traffic to the given file."),
+                                    QStringLiteral("file"));
+    parser.addOption(recordOption);
+    QCommandLineOption traceOption(QStringLiteral("trace"),
+                                   QStringLiteral("Write the hot paths trace (Chrome trace format) to the given file on exit."),
+                                   QStringLiteral("file"));
+    parser.addOption(traceOption);
+    QCommandLineOption headlessOption(QStringLiteral("headless"),
+                                      QStringLiteral("Run the scenario without the GUI and print its timing report."));
+    parser.addOption(headlessOption);
+    QCommandLineOption scenarioOption(QStringLiteral("scenario"),
+                                      QStringLiteral("The (JSON) scenario to run in the headless mode."),
+                                      QStringLiteral("file"));
+    parser.addOption(scenarioOption);
+    parser.process(*a);
+
+    if (parser.isSet(headlessOption)) {
+        if (!parser.isSet(scenarioOption)) {
+            QTextStream(stderr) << "The headless mode needs a --scenario" << '\n';
+            return 1;
+        }
+        return runScenario(a.data(), parser.value(scenarioOption),
+                           parser.value(recordOption), parser.value(traceOption));
+    }
+
     MainWindow w;
+    if (parser.isSet(recordOption)) {
+        w.startRecording(parser.value(recordOption));
+    }
+    if (parser.isSet(traceOption)) {
+        w.startTracing(parser.value(traceOption));
+    }
     w.show();
 
-    return a.exec();
+    return a->exec();
 }
@@ -0,0 +1,239 @@
+#include "LoadClient.hpp"
+
+#include "LoadGenerator.hpp"
+
+#include <TelepathyQt/AccountFactory>
+#include <TelepathyQt/ChannelClassSpec>
+#include <TelepathyQt/ChannelFactory>
+#include <TelepathyQt/ConnectionFactory>
+#include <TelepathyQt/ContactFactory>
+#include <TelepathyQt/ContactManager>
+#include <TelepathyQt/MethodInvocationContext>
+#include <TelepathyQt/PendingContacts>
+#include <TelepathyQt/PendingReady>
+#include <TelepathyQt/Presence>
+
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(lcSimpleLoadClient, "simple.loadClient", QtWarningMsg)
+
+class LoadClientHandler : public Tp::AbstractClientHandler
+{
+public:
+    explicit LoadClientHandler(LoadClient *client)
+        : Tp::AbstractClientHandler(Tp::ChannelClassSpecList()
+                                    << Tp::ChannelClassSpec::textChat()
+                                    << Tp::ChannelClassSpec::textChatroom())
+        , m_client(client)
+    {
+    }
+
+    bool bypassApproval() const override
+    {
+        return true;
+    }
+
+    void handleChannels(const Tp::MethodInvocationContextPtr<> &context,
+                        const Tp::AccountPtr &account,
+                        const Tp::ConnectionPtr &connection,
+                        const QList<Tp::ChannelPtr> &channels,
+                        const QList<Tp::ChannelRequestPtr> &requestsSatisfied,
+                        const QDateTime &userActionTime,
+                        const Tp::AbstractClientHandler::HandlerInfo &handlerInfo) override
+    {
+        Q_UNUSED(account)
+        Q_UNUSED(connection)
+        Q_UNUSED(requestsSatisfied)
+        Q_UNUSED(userActionTime)
+        Q_UNUSED(handlerInfo)
+
+        for (const Tp::ChannelPtr &channel : channels) {
+            const Tp::TextChannelPtr textChannel = Tp::TextChannelPtr::qObjectCast(channel);
+            if (textChannel) {
+                m_client->addTextChannel(textChannel);
+            }
+        }
+        context->setFinished();
+    }
+
+protected:
+    LoadClient *m_client;
+};
+
+LoadClient::LoadClient(QObject *parent)
+    : QObject(parent)
+{
+}
+
+LoadClient::~LoadClient()
+{
+    if (m_registrar && m_handler) {
+        m_registrar->unregisterClient(m_handler);
+    }
+}
+
+bool LoadClient::registerHandler(const QDBusConnection &bus, const QString &clientName)
+{
+    const Tp::Features textFeatures = Tp::Features() << Tp::TextChannel::FeatureMessageQueue;
+    Tp::ChannelFactoryPtr channelFactory = Tp::ChannelFactory::create(bus);
+    channelFactory->addFeaturesForTextChats(textFeatures);
+    channelFactory->addFeaturesForTextChatrooms(textFeatures);
+
+    m_registrar = Tp::ClientRegistrar::create(Tp::AccountFactory::create(bus),
+                                              Tp::ConnectionFactory::create(bus),
+                                              channelFactory,
+                                              Tp::ContactFactory::create());
+    m_handler = Tp::AbstractClientPtr(new LoadClientHandler(this));
+    return m_registrar->registerClient(m_handler, clientName);
+}
+
+void LoadClient::setConnection(const Tp::ConnectionPtr &connection)
+{
+    if (m_connection == connection) {
+        return;
+    }
+    m_connection = connection;
+
+    if (!m_handler) {
+        connection->dbusConnection().connect(connection->busName(), connection->objectPath(),
+                                             TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS, QLatin1String("NewChannels"),
+                                             this, SLOT(onNewChannels(Tp::ChannelDetailsList)));
+    }
+
+    const Tp::Features features = Tp::Features()
+            << Tp::Connection::FeatureCore
+            << Tp::Connection::FeatureConnected
+            << Tp::Connection::FeatureRoster;
+    connect(connection->becomeReady(features), &Tp::PendingOperation::finished,
+            this, &LoadClient::onConnectionReady);
+}
+
+int LoadClient::watchedContactCount() const
+{
+    return m_contacts.count();
+}
+
+int LoadClient::channelCount() const
+{
+    return m_channels.count();
+}
+
+void LoadClient::addTextChannel(const Tp::TextChannelPtr &channel)
+{
+    const QString path = channel->objectPath();
+    if (m_channels.contains(path)) {
+        return;
+    }
+    m_channels.insert(path, channel);
+
+    // Queued: the proxy must not be released from its own signal
+    connect(channel.data(), &Tp::DBusProxy::invalidated, this, [this, path]() {
+        const auto it = m_channels.find(path);
+        if ((it != m_channels.end()) && !it.value()->isValid()) {
+            m_channels.erase(it);
+        }
+    }, Qt::QueuedConnection);
+
+    Tp::TextChannel *textChannel = channel.data();
+    auto consumeQueue = [this, textChannel]() {
+        // The messages queued before the channel got ready are not signalled
+        const QList<Tp::ReceivedMessage> queue = textChannel->messageQueue();
+        for (const Tp::ReceivedMessage &message : queue) {
+            consumeMessage(textChannel, message);
+        }
+        connect(textChannel, &Tp::TextChannel::messageReceived, this, [this, textChannel](const Tp::ReceivedMessage &message) {
+            consumeMessage(textChannel, message);
+        });
+    };
+
+    const Tp::Features features = Tp::Features() << Tp::TextChannel::FeatureMessageQueue;
+    if (channel->isReady(features)) {
+        consumeQueue();
+        return;
+    }
+    connect(channel->becomeReady(features), &Tp::PendingOperation::finished, this, [consumeQueue](Tp::PendingOperation *operation) {
+        if (operation->isError()) {
+            qCWarning(lcSimpleLoadClient) << "Unable to make the channel ready:"
+                                          << operation->errorName() << operation->errorMessage();
+            return;
+        }
+        consumeQueue();
+    });
+}
+
+void LoadClient::onConnectionReady(Tp::PendingOperation *operation)
+{
+    if (operation->isError()) {
+        qCWarning(lcSimpleLoadClient) << "Unable to make the connection ready:"
+                                      << operation->errorName() << operation->errorMessage();
+        return;
+    }
+
+    Tp::ContactManagerPtr contactManager = m_connection->contactManager();
+    connect(contactManager.data(), &Tp::ContactManager::allKnownContactsChanged,
+            this, &LoadClient::onAllKnownContactsChanged);
+    watchContacts(contactManager->allKnownContacts().toList());
+
+    emit ready();
+}
+
+void LoadClient::onContactsUpgraded(Tp::PendingOperation *operation)
+{
+    if (operation->isError()) {
+        qCWarning(lcSimpleLoadClient) << "Unable to upgrade the contacts:"
+                                      << operation->errorName() << operation->errorMessage();
+        return;
+    }
+
+    Tp::PendingContacts *pendingContacts = qobject_cast<Tp::PendingContacts *>(operation);
+    for (const Tp::ContactPtr &contact : pendingContacts->contacts()) {
+        const QString identifier = contact->id();
+        if (m_contacts.contains(identifier)) {
+            continue;
+        }
+        m_contacts.insert(identifier, contact);
+        connect(contact.data(), &Tp::Contact::presenceChanged, this, [this, identifier](const Tp::Presence &presence) {
+            emit presenceChanged(identifier, presence.status(), LoadGenerator::now());
+        });
+    }
+
+    emit watchedContactsChanged(m_contacts.count());
+}
+
+void LoadClient::onAllKnownContactsChanged(const Tp::Contacts &added, const Tp::Contacts &removed)
+{
+    for (const Tp::ContactPtr &contact : removed) {
+        contact->disconnect(this);
+        m_contacts.remove(contact->id());
+    }
+    watchContacts(added.toList());
+}
+
+void LoadClient::onNewChannels(const Tp::ChannelDetailsList &channels)
+{
+    for (const Tp::ChannelDetails &details : channels) {
+        const QString channelType = details.properties.value(TP_QT_IFACE_CHANNEL + QLatin1String(".ChannelType")).toString();
+        if (channelType != TP_QT_IFACE_CHANNEL_TYPE_TEXT) {
+            continue;
+        }
+        addTextChannel(Tp::TextChannel::create(m_connection, details.channel.path(), details.properties));
+    }
+}
+
+void LoadClient::watchContacts(const QList<Tp::ContactPtr> &contacts)
+{
+    if (contacts.isEmpty()) {
+        return;
+    }
+
+    const Tp::Features features = Tp::Features() << Tp::Contact::FeatureSimplePresence;
+    Tp::PendingContacts *operation = m_connection->contactManager()->upgradeContacts(contacts, features);
+    connect(operation, &Tp::PendingOperation::finished, this, &LoadClient::onContactsUpgraded);
+}
+
+void LoadClient::consumeMessage(Tp::TextChannel *channel, const Tp::ReceivedMessage &message)
+{
+    const qint64 receivedAt = LoadGenerator::now();
+    emit messageReceived(message.text(), receivedAt);
+    channel->acknowledge(QList<Tp::ReceivedMessage>() << message);
+}
@@ -0,0 +1,59 @@
+#ifndef SIMPLE_LOAD_CLIENT_HPP
+#define SIMPLE_LOAD_CLIENT_HPP
+
+#include <TelepathyQt/AbstractClientHandler>
+#include <TelepathyQt/ClientRegistrar>
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/Contact>
+#include <TelepathyQt/PendingOperation>
+#include <TelepathyQt/TextChannel>
+#include <TelepathyQt/Types>
+
+#include <QHash>
+#include <QObject>
+
+/* A Telepathy client consuming the roster presences and the incoming messages of a connection */
+class LoadClient : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LoadClient(QObject *parent = nullptr);
+    ~LoadClient() override;
+
+    // Handles the text channels dispatched by the Channel Dispatcher (needed with an account manager)
+    bool registerHandler(const QDBusConnection &bus, const QString &clientName);
+
+    // Without a handler the text channels are picked up from the Requests.NewChannels signal
+    void setConnection(const Tp::ConnectionPtr &connection);
+
+    int watchedContactCount() const;
+    int channelCount() const;
+
+    void addTextChannel(const Tp::TextChannelPtr &channel);
+
+signals:
+    void ready();
+    void watchedContactsChanged(int count);
+
+    // The time is LoadGenerator::now()
+    void messageReceived(const QString &text, qint64 receivedAt);
+    void presenceChanged(const QString &identifier, const QString &status, qint64 receivedAt);
+
+protected slots:
+    void onConnectionReady(Tp::PendingOperation *operation);
+    void onContactsUpgraded(Tp::PendingOperation *operation);
+    void onAllKnownContactsChanged(const Tp::Contacts &added, const Tp::Contacts &removed);
+    void onNewChannels(const Tp::ChannelDetailsList &channels);
+
+protected:
+    void watchContacts(const QList<Tp::ContactPtr> &contacts);
+    void consumeMessage(Tp::TextChannel *channel, const Tp::ReceivedMessage &message);
+
+    Tp::ConnectionPtr m_connection;
+    Tp::ClientRegistrarPtr m_registrar;
+    Tp::AbstractClientPtr m_handler;
+    QHash<QString, Tp::TextChannelPtr> m_channels;
+    QHash<QString, Tp::ContactPtr> m_contacts;
+};
+
+#endif // SIMPLE_LOAD_CLIENT_HPP
@@ -0,0 +1,264 @@
+#include "LoadGenerator.hpp"
+
+#ifndef SIMPLECM_ENABLE_LOWLEVEL_API
+#define SIMPLECM_ENABLE_LOWLEVEL_API
+#endif
+
+#include <SimpleCM/Chat>
+#include <SimpleCM/Message>
+#include <SimpleCM/Service>
+#include <SimpleCM/ServiceLowLevel>
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <chrono>
+
+// Limits the host calls per tick so the client keeps up with a generator running behind
+static const int c_maxBurst = 1000;
+
+double LoadReport::throughput(int count, qint64 elapsed)
+{
+    if (elapsed <= 0) {
+        return 0;
+    }
+    return count * 1000000.0 / elapsed;
+}
+
+LoadGenerator::LoadGenerator(SimpleCM::Service *service, QObject *parent)
+    : QObject(parent)
+    , m_service(service)
+{
+    m_tickTimer.setTimerType(Qt::PreciseTimer);
+    m_tickTimer.setInterval(1);
+    connect(&m_tickTimer, &QTimer::timeout, this, &LoadGenerator::tick);
+}
+
+qint64 LoadGenerator::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LoadGenerator::setAccount(const QString &account)
+{
+    m_account = account;
+}
+
+void LoadGenerator::setContactCount(int count)
+{
+    m_contacts.clear();
+    m_contacts.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        m_contacts << QStringLiteral("load_contact%1").arg(i);
+    }
+    m_online = QVector<bool>(count, false);
+}
+
+void LoadGenerator::setPresenceRate(double perSecond)
+{
+    m_presenceRate = qMax(0.0, perSecond);
+}
+
+void LoadGenerator::setMessageRate(double perSecond)
+{
+    m_messageRate = qMax(0.0, perSecond);
+}
+
+void LoadGenerator::setMessageSize(int minimum, int maximum)
+{
+    m_minimumSize = qMax(1, minimum);
+    m_maximumSize = qMax(m_minimumSize, maximum);
+}
+
+void LoadGenerator::setSizeDistribution(SizeDistribution distribution)
+{
+    m_sizeDistribution = distribution;
+}
+
+void LoadGenerator::setJsonRatio(double ratio)
+{
+    m_jsonRatio = qBound(0.0, ratio, 1.0);
+}
+
+void LoadGenerator::setSeed(quint32 seed)
+{
+    m_random.seed(seed);
+}
+
+QStringList LoadGenerator::contacts() const
+{
+    return m_contacts;
+}
+
+int LoadGenerator::pendingCount() const
+{
+    return m_pendingMessages.count() + m_pendingPresences.count();
+}
+
+LoadReport LoadGenerator::report() const
+{
+    return m_report;
+}
+
+void LoadGenerator::populateRoster()
+{
+    m_service->setContactList(m_account, m_contacts);
+}
+
+void LoadGenerator::start(int durationMsecs)
+{
+    m_report = LoadReport();
+    m_pendingMessages.clear();
+    m_pendingPresences.clear();
+    m_duration = qint64(durationMsecs) * 1000000;
+    m_startedAt = now();
+    m_tickTimer.start();
+}
+
+void LoadGenerator::stop()
+{
+    if (!m_tickTimer.isActive()) {
+        return;
+    }
+    m_tickTimer.stop();
+    m_report.elapsed = (now() - m_startedAt) / 1000;
+    emit finished();
+}
+
+void LoadGenerator::onMessageReceived(const QString &text, qint64 receivedAt)
+{
+    // The text starts with "#<sequence> "
+    if (!text.startsWith(QLatin1Char('#'))) {
+        return;
+    }
+    const int end = text.indexOf(QLatin1Char(' '));
+    bool ok = false;
+    const quint64 sequence = text.midRef(1, end < 0 ? -1 : end - 1).toULongLong(&ok);
+    if (!ok) {
+        return;
+    }
+
+    const auto pending = m_pendingMessages.find(sequence);
+    if (pending == m_pendingMessages.end()) {
+        return;
+    }
+    m_report.messageLatencies.append((receivedAt - pending.value()) / 1000);
+    m_pendingMessages.erase(pending);
+}
+
+void LoadGenerator::onPresenceChanged(const QString &identifier, const QString &status, qint64 receivedAt)
+{
+    // Only the latest change of a contact is awaited; the intermediate ones are superseded
+    const auto pending = m_pendingPresences.find(identifier);
+    if ((pending == m_pendingPresences.end()) || (pending.value().status != status)) {
+        return;
+    }
+    m_report.presenceLatencies.append((receivedAt - pending.value().changedAt) / 1000);
+    m_pendingPresences.erase(pending);
+}
+
+void LoadGenerator::tick()
+{
+    const qint64 elapsed = now() - m_startedAt;
+    const double seconds = elapsed / 1000000000.0;
+
+    const int dueMessages = qMin<qint64>(c_maxBurst, static_cast<qint64>(m_messageRate * seconds) - m_report.messages);
+    for (int i = 0; i < dueMessages; ++i) {
+        sendMessage();
+    }
+
+    if (!m_contacts.isEmpty()) {
+        const int duePresences = qMin<qint64>(c_maxBurst, static_cast<qint64>(m_presenceRate * seconds) - m_report.presences);
+        for (int i = 0; i < duePresences; ++i) {
+            changePresence();
+        }
+    }
+
+    if (elapsed >= m_duration) {
+        stop();
+    }
+}
+
+void LoadGenerator::sendMessage()
+{
+    const quint64 sequence = m_nextSequence++;
+    const QString contact = m_contacts.isEmpty()
+            ? QStringLiteral("load_peer")
+            : m_contacts.at(static_cast<int>(m_random() % static_cast<quint32>(m_contacts.count())));
+
+    QString text = QStringLiteral("#%1 ").arg(sequence);
+    const int size = nextMessageSize();
+    if (text.size() < size) {
+        text.append(QString(size - text.size(), QLatin1Char('x')));
+    }
+
+    const bool json = std::uniform_real_distribution<double>(0, 1)(m_random) < m_jsonRatio;
+    const SimpleCM::Chat chat = SimpleCM::Chat::fromContactId(contact);
+
+    QByteArray jsonData;
+    if (json) {
+        const qint64 timestamp = QDateTime::currentSecsSinceEpoch();
+        const QJsonObject header = {
+            { QStringLiteral("message-received"), timestamp },
+            { QStringLiteral("message-sender-id"), contact },
+            { QStringLiteral("message-sent"), timestamp },
+            { QStringLiteral("message-token"), QStringLiteral("loadgen-%1").arg(sequence) },
+            { QStringLiteral("message-type"), 0 },
+        };
+        const QJsonObject body = {
+            { QStringLiteral("content"), text },
+            { QStringLiteral("content-type"), QStringLiteral("text/plain") },
+        };
+        jsonData = QJsonDocument(QJsonArray({ header, body })).toJson(QJsonDocument::Compact);
+    }
+
+    m_pendingMessages.insert(sequence, now());
+    ++m_report.messages;
+
+    if (json) {
+        ++m_report.jsonMessages;
+        m_service->lowLevel()->sendJsonMessage(m_account, chat, jsonData);
+        return;
+    }
+
+    SimpleCM::Message message;
+    message.account = m_account;
+    message.chat = chat;
+    message.from = contact;
+    message.text = text;
+    m_service->addMessage(message);
+}
+
+void LoadGenerator::changePresence()
+{
+    const int index = static_cast<int>(m_random() % static_cast<quint32>(m_contacts.count()));
+    m_online[index] = !m_online.at(index);
+
+    const QString &contact = m_contacts.at(index);
+    const QString status = m_online.at(index) ? QStringLiteral("available") : QStringLiteral("offline");
+
+    m_pendingPresences.insert(contact, PendingPresence { status, now() });
+    ++m_report.presences;
+    m_service->setContactPresence(m_account, contact, status);
+}
+
+int LoadGenerator::nextMessageSize()
+{
+    if (m_minimumSize == m_maximumSize) {
+        return m_minimumSize;
+    }
+
+    switch (m_sizeDistribution) {
+    case SizeDistribution::Uniform:
+        return std::uniform_int_distribution<int>(m_minimumSize, m_maximumSize)(m_random);
+    case SizeDistribution::Exponential: {
+        const double mean = (m_minimumSize + m_maximumSize) / 2.0 - m_minimumSize;
+        const double size = m_minimumSize + std::exponential_distribution<double>(1.0 / mean)(m_random);
+        return qMin(m_maximumSize, static_cast<int>(size));
+    }
+    }
+
+    return m_minimumSize;
+}
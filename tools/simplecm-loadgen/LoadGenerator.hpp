@@ -0,0 +1,109 @@
+#ifndef SIMPLE_LOAD_GENERATOR_HPP
+#define SIMPLE_LOAD_GENERATOR_HPP
+
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+#include <random>
+
+namespace SimpleCM {
+
+class Service;
+
+} // SimpleCM
+
+struct LoadReport
+{
+    int messages = 0;
+    int jsonMessages = 0;
+    int presences = 0;
+    qint64 elapsed = 0; // us
+
+    // End-to-end latencies in microseconds (host call -> client signal)
+    QVector<qint64> messageLatencies;
+    QVector<qint64> presenceLatencies;
+
+    static double throughput(int count, qint64 elapsed);
+};
+
+/* Drives a SimpleCM::Service with a configurable contacts, presence and messages load */
+class LoadGenerator : public QObject
+{
+    Q_OBJECT
+public:
+    enum class SizeDistribution {
+        Uniform,
+        Exponential, // Around the mean of the range, clipped to the range
+    };
+
+    explicit LoadGenerator(SimpleCM::Service *service, QObject *parent = nullptr);
+
+    // Monotonic clock shared with the client (ns)
+    static qint64 now();
+
+    void setAccount(const QString &account);
+    void setContactCount(int count);
+    void setPresenceRate(double perSecond);
+    void setMessageRate(double perSecond);
+    void setMessageSize(int minimum, int maximum);
+    void setSizeDistribution(SizeDistribution distribution);
+    // Share of the messages injected as JSON (0..1)
+    void setJsonRatio(double ratio);
+    void setSeed(quint32 seed);
+
+    QStringList contacts() const;
+    // Host calls sent but not observed by the client yet
+    int pendingCount() const;
+
+    LoadReport report() const;
+
+signals:
+    void finished();
+
+public slots:
+    void populateRoster();
+    void start(int durationMsecs);
+    void stop();
+
+    void onMessageReceived(const QString &text, qint64 receivedAt);
+    void onPresenceChanged(const QString &identifier, const QString &status, qint64 receivedAt);
+
+protected slots:
+    void tick();
+
+protected:
+    void sendMessage();
+    void changePresence();
+    int nextMessageSize();
+
+    struct PendingPresence {
+        QString status;
+        qint64 changedAt;
+    };
+
+    SimpleCM::Service *m_service = nullptr;
+    QString m_account;
+    QStringList m_contacts;
+    QVector<bool> m_online;
+    double m_presenceRate = 10;
+    double m_messageRate = 10;
+    int m_minimumSize = 64;
+    int m_maximumSize = 64;
+    SizeDistribution m_sizeDistribution = SizeDistribution::Uniform;
+    double m_jsonRatio = 0;
+    std::mt19937 m_random;
+
+    QTimer m_tickTimer;
+    qint64 m_startedAt = 0;
+    qint64 m_duration = 0; // ns
+    quint64 m_nextSequence = 0;
+
+    QHash<quint64, qint64> m_pendingMessages;
+    QHash<QString, PendingPresence> m_pendingPresences;
+    LoadReport m_report;
+};
+
+#endif // SIMPLE_LOAD_GENERATOR_HPP
@@ -0,0 +1,307 @@
+#ifndef SIMPLECM_ENABLE_LOWLEVEL_API
+#define SIMPLECM_ENABLE_LOWLEVEL_API
+#endif
+
+#include <SimpleCM/Service>
+#include <SimpleCM/ServiceLowLevel>
+#include <SimpleCM/TrafficReplayer>
+
+#include <TelepathyQt/Account>
+#include <TelepathyQt/BaseConnection>
+#include <TelepathyQt/ChannelFactory>
+#include <TelepathyQt/Connection>
+#include <TelepathyQt/ContactFactory>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QTimer>
+
+#include "AccountHelper.hpp"
+#include "AccountProvisioner.hpp"
+#include "LoadClient.hpp"
+#include "LoadGenerator.hpp"
+#include "PrivateBus.hpp"
+
+static const QString c_clientConnectionName = QStringLiteral("simplecm-loadgen-client");
+
+static void printLatencies(QTextStream &out, const QString &name, int sent, const QVector<qint64> &latencies, qint64 elapsed)
+{
+    out << name << ": sent " << sent
+        << " received " << latencies.count()
+        << " throughput " << LoadReport::throughput(latencies.count(), elapsed) << "/s"
+        << " latency (us): p50 " << SimpleCM::TrafficReplayReport::percentile(latencies, 50)
+        << " p99 " << SimpleCM::TrafficReplayReport::percentile(latencies, 99)
+        << " p999 " << SimpleCM::TrafficReplayReport::percentile(latencies, 99.9)
+        << " max " << SimpleCM::TrafficReplayReport::percentile(latencies, 100) << '\n';
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Generates contacts, presence and message load on a SimpleCM::Service "
+                                                    "and measures it end-to-end with a Telepathy client"));
+    parser.addHelpOption();
+
+    QCommandLineOption managerOption(QStringLiteral("manager"), QStringLiteral("Connection manager name."),
+                                     QStringLiteral("name"), QStringLiteral("simplecmload"));
+    QCommandLineOption protocolOption(QStringLiteral("protocol"), QStringLiteral("Protocol name."),
+                                      QStringLiteral("name"), QStringLiteral("simplecm"));
+    QCommandLineOption selfIdOption(QStringLiteral("self-id"), QStringLiteral("Identifier of the local account."),
+                                    QStringLiteral("id"), QStringLiteral("local_user"));
+    QCommandLineOption contactsOption(QStringLiteral("contacts"), QStringLiteral("Number of roster contacts."),
+                                      QStringLiteral("count"), QStringLiteral("100"));
+    QCommandLineOption presenceRateOption(QStringLiteral("presence-rate"), QStringLiteral("Presence changes per second."),
+                                          QStringLiteral("rate"), QStringLiteral("10"));
+    QCommandLineOption messageRateOption(QStringLiteral("message-rate"), QStringLiteral("Incoming messages per second."),
+                                         QStringLiteral("rate"), QStringLiteral("10"));
+    QCommandLineOption messageSizeOption(QStringLiteral("message-size"), QStringLiteral("Message text size or range, e.g. 64 or 16-4096."),
+                                         QStringLiteral("bytes"), QStringLiteral("64"));
+    QCommandLineOption distributionOption(QStringLiteral("size-distribution"), QStringLiteral("Message size distribution (uniform, exponential)."),
+                                          QStringLiteral("name"), QStringLiteral("uniform"));
+    QCommandLineOption jsonRatioOption(QStringLiteral("json-ratio"), QStringLiteral("Share of the messages injected as JSON (0..1)."),
+                                       QStringLiteral("ratio"), QStringLiteral("0"));
+    QCommandLineOption durationOption(QStringLiteral("duration"), QStringLiteral("Load duration."),
+                                      QStringLiteral("secs"), QStringLiteral("10"));
+    QCommandLineOption drainOption(QStringLiteral("drain-timeout"), QStringLiteral("Time to wait for the pending client signals."),
+                                   QStringLiteral("msecs"), QStringLiteral("5000"));
+    QCommandLineOption seedOption(QStringLiteral("seed"), QStringLiteral("Random seed."),
+                                  QStringLiteral("seed"), QStringLiteral("1"));
+    QCommandLineOption privateBusOption(QStringLiteral("private-bus"), QStringLiteral("Run against a private dbus-daemon."));
+    QCommandLineOption accountManagerOption(QStringLiteral("account-manager"),
+                                            QStringLiteral("Create and connect the account via the account manager instead of a direct connection."));
+    QCommandLineOption provisionOption(QStringLiteral("provision"),
+                                       QStringLiteral("Only create and bring online the given number of accounts via the account manager "
+                                                      "and report the time to online."),
+                                       QStringLiteral("count"));
+    QCommandLineOption provisionConcurrencyOption(QStringLiteral("provision-concurrency"),
+                                                  QStringLiteral("Accounts being provisioned at once."),
+                                                  QStringLiteral("count"), QStringLiteral("8"));
+    QCommandLineOption provisionSelfIdOption(QStringLiteral("provision-self-id"),
+                                             QStringLiteral("Self id of the provisioned accounts, %1 is replaced by the account number."),
+                                             QStringLiteral("pattern"), QStringLiteral("provisioned_%1"));
+    QCommandLineOption provisionTimeoutOption(QStringLiteral("provision-timeout"),
+                                              QStringLiteral("Time for an account to get online."),
+                                              QStringLiteral("msecs"), QStringLiteral("30000"));
+    QCommandLineOption keepAccountsOption(QStringLiteral("keep-accounts"),
+                                          QStringLiteral("Do not remove the provisioned accounts on exit."));
+    parser.addOptions({ managerOption, protocolOption, selfIdOption, contactsOption, presenceRateOption,
+                        messageRateOption, messageSizeOption, distributionOption, jsonRatioOption,
+                        durationOption, drainOption, seedOption, privateBusOption, accountManagerOption,
+                        provisionOption, provisionConcurrencyOption, provisionSelfIdOption,
+                        provisionTimeoutOption, keepAccountsOption });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    PrivateBus privateBus;
+    if (parser.isSet(privateBusOption) && !privateBus.start()) {
+        err << "Unable to start a private bus" << '\n';
+        return 1;
+    }
+
+    SimpleCM::Service service;
+    service.setManagerName(parser.value(managerOption));
+    service.setProtocolName(parser.value(protocolOption));
+    if (!service.start()) {
+        err << "Unable to start the service" << '\n';
+        return 1;
+    }
+
+    if (parser.isSet(provisionOption)) {
+        AccountProvisioner provisioner;
+        provisioner.setManagerName(parser.value(managerOption));
+        provisioner.setProtocolName(parser.value(protocolOption));
+        provisioner.setSelfIdPattern(parser.value(provisionSelfIdOption));
+        provisioner.setConcurrency(parser.value(provisionConcurrencyOption).toInt());
+        provisioner.setTimeout(parser.value(provisionTimeoutOption).toInt());
+
+        QObject::connect(&provisioner, &AccountProvisioner::accountOnline, [&](int index) {
+            const ProvisionedAccount account = provisioner.accounts().at(index);
+            out << account.selfId << ": online in " << account.timeToOnline() / 1000.0 << " ms"
+                << " (created " << (account.createdAt - account.startedAt) / 1000.0 << " ms"
+                << ", enabled " << (account.enabledAt - account.startedAt) / 1000.0 << " ms)" << '\n';
+            out.flush();
+        });
+        QObject::connect(&provisioner, &AccountProvisioner::accountFailed, [&](int index, const QString &error) {
+            out << provisioner.accounts().at(index).selfId << ": failed: " << error << '\n';
+            out.flush();
+        });
+        QObject::connect(&provisioner, &AccountProvisioner::finished, [&]() {
+            QVector<qint64> timesToOnline;
+            for (const ProvisionedAccount &account : provisioner.accounts()) {
+                if (account.onlineAt) {
+                    timesToOnline.append(account.timeToOnline());
+                }
+            }
+            out << "Accounts: " << provisioner.onlineCount() << " online, " << provisioner.failedCount() << " failed"
+                << " in " << provisioner.elapsed() / 1000.0 << " ms"
+                << " (" << LoadReport::throughput(provisioner.onlineCount(), provisioner.elapsed()) << "/s)"
+                << " time to online (ms): p50 " << SimpleCM::TrafficReplayReport::percentile(timesToOnline, 50) / 1000.0
+                << " p90 " << SimpleCM::TrafficReplayReport::percentile(timesToOnline, 90) / 1000.0
+                << " p99 " << SimpleCM::TrafficReplayReport::percentile(timesToOnline, 99) / 1000.0
+                << " max " << SimpleCM::TrafficReplayReport::percentile(timesToOnline, 100) / 1000.0 << '\n';
+            out.flush();
+
+            if (parser.isSet(keepAccountsOption)) {
+                app.quit();
+                return;
+            }
+            provisioner.removeAccounts();
+        });
+        QObject::connect(&provisioner, &AccountProvisioner::accountsRemoved, &app, &QCoreApplication::quit);
+
+        provisioner.provision(parser.value(provisionOption).toInt());
+        return app.exec();
+    }
+
+    const bool useAccountManager = parser.isSet(accountManagerOption);
+    const QStringList sizeRange = parser.value(messageSizeOption).split(QLatin1Char('-'));
+
+    LoadGenerator generator(&service);
+    // In the account manager mode the account is set once the account is connected
+    generator.setAccount(parser.value(selfIdOption));
+    generator.setContactCount(qMax(0, parser.value(contactsOption).toInt()));
+    generator.setPresenceRate(parser.value(presenceRateOption).toDouble());
+    generator.setMessageRate(parser.value(messageRateOption).toDouble());
+    generator.setMessageSize(sizeRange.constFirst().toInt(), sizeRange.constLast().toInt());
+    generator.setSizeDistribution(parser.value(distributionOption) == QLatin1String("exponential")
+                                  ? LoadGenerator::SizeDistribution::Exponential
+                                  : LoadGenerator::SizeDistribution::Uniform);
+    generator.setJsonRatio(parser.value(jsonRatioOption).toDouble());
+    generator.setSeed(parser.value(seedOption).toUInt());
+
+    // The client has its own bus connection, as a separate process would
+    const QDBusConnection clientBus = QDBusConnection::connectToBus(QDBusConnection::SessionBus, c_clientConnectionName);
+    if (!clientBus.isConnected()) {
+        err << "Unable to connect the client to the bus" << '\n';
+        return 1;
+    }
+
+    LoadClient client;
+    QObject::connect(&client, &LoadClient::messageReceived, &generator, &LoadGenerator::onMessageReceived);
+    QObject::connect(&client, &LoadClient::presenceChanged, &generator, &LoadGenerator::onPresenceChanged);
+
+    const int durationMsecs = qMax(1, parser.value(durationOption).toInt()) * 1000;
+    const int drainTimeout = parser.value(drainOption).toInt();
+    const int contactCount = generator.contacts().count();
+    bool started = false;
+    QElapsedTimer elapsedTimer;
+
+    auto startLoad = [&]() {
+        if (started) {
+            return;
+        }
+        started = true;
+        out << "Generating the load for " << durationMsecs / 1000 << " s" << '\n';
+        out.flush();
+        elapsedTimer.start();
+        generator.start(durationMsecs);
+    };
+
+    // The roster is announced once the client listens, the load starts once all contacts are watched
+    QObject::connect(&client, &LoadClient::ready, [&]() {
+        if (contactCount == 0) {
+            startLoad();
+            return;
+        }
+        generator.populateRoster();
+    });
+    QObject::connect(&client, &LoadClient::watchedContactsChanged, [&](int count) {
+        if (count >= contactCount) {
+            startLoad();
+        }
+    });
+
+    QTimer drainTimer;
+    drainTimer.setInterval(20);
+    QElapsedTimer drainElapsed;
+    QObject::connect(&generator, &LoadGenerator::finished, [&]() {
+        drainElapsed.start();
+        drainTimer.start();
+    });
+    QObject::connect(&drainTimer, &QTimer::timeout, [&]() {
+        if ((generator.pendingCount() > 0) && !drainElapsed.hasExpired(drainTimeout)) {
+            return;
+        }
+        drainTimer.stop();
+
+        const LoadReport report = generator.report();
+        const qint64 elapsed = elapsedTimer.nsecsElapsed() / 1000;
+        out << "Contacts: " << contactCount << " channels: " << client.channelCount() << '\n';
+        out << "Elapsed: " << elapsed / 1000.0 << " ms"
+            << " (generating " << report.elapsed / 1000.0 << " ms)" << '\n';
+        printLatencies(out, QStringLiteral("Messages (JSON: %1)").arg(report.jsonMessages),
+                       report.messages, report.messageLatencies, elapsed);
+        printLatencies(out, QStringLiteral("Presences"), report.presences, report.presenceLatencies, elapsed);
+        out.flush();
+        app.quit();
+    });
+
+    AccountHelper accountHelper;
+    bool accountRequested = false;
+    if (useAccountManager) {
+        if (!client.registerHandler(clientBus, QStringLiteral("SimpleCMLoadGen"))) {
+            err << "Unable to register the client handler" << '\n';
+            return 1;
+        }
+
+        accountHelper.setManagerName(parser.value(managerOption));
+        accountHelper.setProtocolName(parser.value(protocolOption));
+
+        QObject::connect(&accountHelper, &AccountHelper::accountsChanged, [&]() {
+            if (accountHelper.currentAccountStatus() != AccountHelper::AccountStatus::NoAccount) {
+                return;
+            }
+            const QStringList accountIds = accountHelper.accountIds();
+            if (!accountIds.isEmpty()) {
+                accountHelper.connectAccount(accountIds.constFirst());
+            } else if (!accountRequested) {
+                accountRequested = true;
+                accountHelper.addAccount();
+            }
+        });
+        QObject::connect(&accountHelper, &AccountHelper::currentAccountStatusChanged, [&]() {
+            if (accountHelper.currentAccountStatus() != AccountHelper::AccountStatus::Connected) {
+                return;
+            }
+            const Tp::AccountPtr account = accountHelper.getAccountById(accountHelper.currentAccountId());
+            generator.setAccount(account->parameters().value(QStringLiteral("self_id")).toString());
+            auto useConnection = [&client, account]() {
+                if (account->connection()) {
+                    client.setConnection(account->connection());
+                }
+            };
+            QObject::connect(account.data(), &Tp::Account::connectionChanged, &client, useConnection);
+            useConnection();
+        });
+        accountHelper.start();
+    } else {
+        Tp::DBusError error;
+        const QVariantMap parameters = {
+            { QStringLiteral("self_id"), parser.value(selfIdOption) },
+        };
+        const Tp::BaseConnectionPtr connection = service.lowLevel()->createConnection(parameters, &error);
+        if (error.isValid()) {
+            err << "Unable to create a connection: " << error.name() << " " << error.message() << '\n';
+            return 1;
+        }
+
+        client.setConnection(Tp::Connection::create(clientBus, connection->busName(), connection->objectPath(),
+                                                    Tp::ChannelFactory::create(clientBus),
+                                                    Tp::ContactFactory::create()));
+    }
+
+    const int result = app.exec();
+
+    if (useAccountManager) {
+        accountHelper.stop();
+    }
+
+    return result;
+}
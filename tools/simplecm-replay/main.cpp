@@ -0,0 +1,128 @@
+#ifndef SIMPLECM_ENABLE_LOWLEVEL_API
+#define SIMPLECM_ENABLE_LOWLEVEL_API
+#endif
+
+#include <SimpleCM/Service>
+#include <SimpleCM/ServiceLowLevel>
+#include <SimpleCM/TrafficReplayer>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QSet>
+#include <QTextStream>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Replays a traffic file recorded from a SimpleCM::Service"));
+    parser.addHelpOption();
+
+    QCommandLineOption managerOption(QStringLiteral("manager"), QStringLiteral("Connection manager name."),
+                                     QStringLiteral("name"), QStringLiteral("simplecm"));
+    QCommandLineOption protocolOption(QStringLiteral("protocol"), QStringLiteral("Protocol name."),
+                                      QStringLiteral("name"), QStringLiteral("simplecm"));
+    QCommandLineOption selfIdOption(QStringLiteral("self-id"), QStringLiteral("Identifier of the account of the records recorded without one."),
+                                    QStringLiteral("id"), QStringLiteral("local_user"));
+    QCommandLineOption speedOption(QStringLiteral("speed"), QStringLiteral("Replay speed factor (1 is the original speed)."),
+                                   QStringLiteral("factor"), QStringLiteral("1"));
+    QCommandLineOption fastOption(QStringLiteral("fast"), QStringLiteral("Replay as fast as possible."));
+    QCommandLineOption drainOption(QStringLiteral("drain-timeout"), QStringLiteral("Time to wait for the pending D-Bus signals."),
+                                   QStringLiteral("msecs"), QStringLiteral("5000"));
+    parser.addOptions({ managerOption, protocolOption, selfIdOption, speedOption, fastOption, drainOption });
+    parser.addPositionalArgument(QStringLiteral("file"), QStringLiteral("Traffic file to replay."));
+    parser.process(app);
+
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.count() != 1) {
+        parser.showHelp(1);
+    }
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    double speed = 0;
+    if (!parser.isSet(fastOption)) {
+        bool ok = false;
+        speed = parser.value(speedOption).toDouble(&ok);
+        if (!ok || (speed <= 0)) {
+            err << "Invalid speed factor: " << parser.value(speedOption) << '\n';
+            return 1;
+        }
+    }
+
+    // Every account of the recording gets its own connection
+    const QString selfId = parser.value(selfIdOption);
+    QStringList accounts;
+    {
+        SimpleCM::TrafficReader reader;
+        if (!reader.open(arguments.constFirst())) {
+            err << "Unable to read " << arguments.constFirst() << '\n';
+            return 1;
+        }
+        QSet<QString> knownAccounts;
+        for (SimpleCM::TrafficRecord record = reader.readNext(); record.type != SimpleCM::TrafficRecord::Invalid;
+             record = reader.readNext()) {
+            const QString account = record.account.isEmpty() ? selfId : record.account;
+            if (!knownAccounts.contains(account)) {
+                knownAccounts.insert(account);
+                accounts << account;
+            }
+        }
+    }
+    if (accounts.isEmpty()) {
+        accounts << selfId;
+    }
+
+    SimpleCM::Service service;
+    service.setManagerName(parser.value(managerOption));
+    service.setProtocolName(parser.value(protocolOption));
+    service.setSelfContactIdentifier(selfId);
+    if (!service.start()) {
+        err << "Unable to start the service" << '\n';
+        return 1;
+    }
+
+    for (const QString &account : accounts) {
+        Tp::DBusError error;
+        const QVariantMap parameters = {
+            { QStringLiteral("self_id"), account },
+        };
+        service.lowLevel()->createConnection(parameters, &error);
+        if (error.isValid()) {
+            err << "Unable to create a connection for " << account << ": "
+                << error.name() << " " << error.message() << '\n';
+            return 1;
+        }
+    }
+
+    SimpleCM::TrafficReplayer replayer(&service);
+    replayer.setSpeed(speed);
+    replayer.setDrainTimeout(parser.value(drainOption).toInt());
+
+    QObject::connect(&replayer, &SimpleCM::TrafficReplayer::finished, &app, [&]() {
+        const SimpleCM::TrafficReplayReport report = replayer.report();
+        out << "Records: " << report.records
+            << " (messages: " << report.messages
+            << ", JSON messages: " << report.jsonMessages
+            << ", presences: " << report.presences
+            << ", contact lists: " << report.contactLists << ")" << '\n';
+        out << "Elapsed: " << report.elapsed / 1000.0 << " ms" << '\n';
+        out << "Throughput: " << report.throughput() << " records/s" << '\n';
+        out << "Latency (us): p50 " << report.latencyPercentile(50)
+            << " p99 " << report.latencyPercentile(99)
+            << " max " << report.latencyPercentile(100)
+            << " (observed: " << report.latencies.count()
+            << ", unobserved: " << report.unobserved << ")" << '\n';
+        out.flush();
+        app.quit();
+    });
+
+    if (!replayer.start(arguments.constFirst())) {
+        err << "Unable to replay " << arguments.constFirst() << '\n';
+        return 1;
+    }
+
+    return app.exec();
+}